@@ -0,0 +1,54 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Adjacency matrix of a pattern of at most 64 vertices, stored as two 64-bit
+// masks per row: the vertices the row links to, and which of those links is
+// the update edge (the entries marked 2 in the int matrices). Rows of up to
+// inline_vertices vertices live inside the object, larger patterns in one
+// heap block, so small patterns copy without allocating.
+class Adjacency
+{
+public:
+    static const int max_vertices = 64;
+    static const int inline_vertices = 16;
+
+    Adjacency() : size(0), rows(buffer) {}
+    explicit Adjacency(int _size);
+    // entries of matrix: 0 no edge, 1 edge, 2 update edge
+    Adjacency(const int* matrix, int _size);
+    Adjacency(const Adjacency& other);
+    Adjacency(Adjacency&& other) noexcept;
+    Adjacency& operator=(const Adjacency& other);
+    Adjacency& operator=(Adjacency&& other) noexcept;
+    ~Adjacency();
+
+    inline int get_size() const {return size;}
+    inline uint64_t row(int x) const {return rows[x];}
+    inline uint64_t marked_row(int x) const {return rows[size + x];}
+    inline bool has_edge(int x, int y) const {return (rows[x] >> y) & 1;}
+    inline int get(int x, int y) const {return has_edge(x, y) ? 1 + static_cast<int>((rows[size + x] >> y) & 1) : 0;}
+    inline int degree(int x) const {return __builtin_popcountll(rows[x]);}
+
+    void set(int x, int y, int value);
+    void add_edge(int x, int y) { set(x, y, 1); set(y, x, 1); }
+    void del_edge(int x, int y) { set(x, y, 0); set(y, x, 0); }
+    void add_update_mapping(int x, int y) { set(x, y, 2); set(y, x, 2); }
+
+    // relabels a as b and b as a
+    void swap_vertices(int a, int b);
+
+    // dense row-major copy with the 0/1/2 entries, for code that indexes
+    // matrices with INDEX()
+    std::vector<int> to_matrix() const;
+
+    bool operator==(const Adjacency& other) const;
+    bool operator!=(const Adjacency& other) const { return !(*this == other); }
+
+private:
+    void allocate(int _size);
+
+    int size;
+    uint64_t* rows;         // size link masks, then size update-edge masks
+    uint64_t buffer[2 * inline_vertices];
+};
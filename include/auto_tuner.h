@@ -0,0 +1,60 @@
+#ifndef AUTO_TUNER_H
+#define AUTO_TUNER_H
+
+#include "match_engine.h"
+#include "cost_model.h"
+#include <string>
+#include <vector>
+#include <utility>
+
+struct TuningReport {
+    size_t configurations;      // configurations timed
+    size_t sample_updates;
+    double initial_us;          // sample time of the configuration in place before tuning
+    double best_us;             // sample time of the configuration locked in
+};
+
+// Picks the matching orders and intersection kernel of a MatchEngine by
+// timing them on real updates. Each schedule's alternatives are tried one
+// at a time with the others fixed at their current best, then every kernel.
+// The sample stops at sample_updates or once the current configuration has
+// spent sample_budget_us on it, and a trial is cut off as soon as it is
+// slower than the best so far, so tuning costs at most a few budgets.
+class AutoTuner {
+public:
+    explicit AutoTuner(size_t top_k = 3, size_t sample_updates = 256, double sample_budget_us = 20000,
+                       double drift_threshold = 0.25)
+        : top_k(top_k), sample_updates(sample_updates), sample_budget_us(sample_budget_us),
+          drift_threshold(drift_threshold), has_baseline(false) {}
+
+    size_t get_top_k() const { return top_k; }
+    size_t get_sample_updates() const { return sample_updates; }
+
+    // Times the configurations on edges[i] mined against views[i] and leaves
+    // the fastest one installed. The engine must not be in use elsewhere.
+    TuningReport tune(MatchEngine& engine, const std::vector<std::pair<int, int>>& edges,
+                      const std::vector<MatchView>& views) const;
+
+    // The graph has drifted once the neighbor degree or the triangle density
+    // moved by more than drift_threshold (relative) since set_baseline().
+    void set_baseline(const GraphStatistics& stats) { baseline = stats; has_baseline = true; }
+    bool drifted(const GraphStatistics& stats) const;
+
+    static bool save(const std::string& path, const MatchConfig& config);
+    static bool load(const std::string& path, MatchConfig& config);
+
+private:
+    // Mines the first n sample updates; gives up and returns a negative
+    // time once cutoff_us has passed.
+    double time_sample(const MatchEngine& engine, const std::vector<std::pair<int, int>>& edges,
+                       const std::vector<MatchView>& views, size_t n, double cutoff_us, size_t& matches) const;
+
+    size_t top_k;
+    size_t sample_updates;
+    double sample_budget_us;
+    double drift_threshold;
+    GraphStatistics baseline;
+    bool has_baseline;
+};
+
+#endif // AUTO_TUNER_H
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#ifndef INDEX
+#define INDEX(x,y,n) ((x)*(n)+(y))
+#endif
+
+// Canonical labeling of a small vertex- and edge-colored graph by partition
+// refinement and individualization. Matrix entries are edge colors (0 = no
+// edge, 2 = update edge in Mappings/Schedule); two graphs are isomorphic iff
+// their canonical forms compare equal. Automorphisms found while searching
+// the individualization tree are kept as generators of the whole group.
+class CanonicalLabeling
+{
+public:
+    CanonicalLabeling(const int* adj_mat, int size, const std::vector<int>& colors = std::vector<int>());
+
+    inline int get_size() const { return size; }
+    inline uint64_t get_hash() const { return hash; }
+    // labeling[v] is the canonical position of vertex v
+    inline const std::vector<int>& get_labeling() const { return labeling; }
+    inline const std::vector<int>& get_matrix() const { return matrix; }
+    inline const std::vector< std::vector<int> >& get_generators() const { return generators; }
+
+    bool same_orbit(int x, int y) const { return orbit[x] == orbit[y]; }
+    inline const std::vector<int>& get_orbits() const { return orbit; }   // smallest vertex of each orbit
+    std::vector< std::vector<int> > get_automorphisms() const;
+
+    bool operator==(const CanonicalLabeling& other) const;
+    bool operator!=(const CanonicalLabeling& other) const { return !(*this == other); }
+
+private:
+    void refine(std::vector<int>& cell) const;
+    void search(std::vector<int>& cell, std::vector<int>& path);
+    void leaf(const std::vector<int>& cell);
+    void add_generator(const std::vector<int>& perm);
+
+    const int* adj;
+    int size;
+    std::vector<int> input_colors;
+
+    std::vector<int> labeling;
+    std::vector<int> colors;        // input colors in canonical order
+    std::vector<int> matrix;
+    std::vector<int> first_labeling;
+    std::vector<int> first_matrix;
+    std::vector< std::vector<int> > generators;
+    std::vector<int> orbit;
+    uint64_t hash;
+};
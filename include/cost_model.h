@@ -0,0 +1,55 @@
+#ifndef COST_MODEL_H
+#define COST_MODEL_H
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstddef>
+
+#ifndef INDEX
+#define INDEX(x,y,n) ((x)*(n)+(y))
+#endif
+
+typedef std::unordered_map<int, std::unordered_set<int>> AdjacencyMap;
+
+// Data graph summary the schedule cost model works from. Degree moments and
+// the hub split are exact; triangle density is estimated from sampled
+// neighbor pairs.
+struct GraphStatistics {
+    size_t vertices;
+    size_t edges;
+    double mean_degree;         // E[d]
+    double second_moment;       // E[d^2]
+    double triangle_density;    // P(two neighbors of a vertex are adjacent)
+    double hub_fraction;        // share of adjacency entries owned by hubs
+    double hub_degree;          // size-biased degree among hubs
+    double other_degree;        // size-biased degree among the other vertices
+
+    // degree of a vertex reached over an edge, E[d^2] / E[d]
+    double neighbor_degree() const { return mean_degree > 0 ? second_moment / mean_degree : 0.0; }
+
+    static GraphStatistics sample(const AdjacencyMap& graph, size_t samples = default_samples);
+
+    static const size_t default_samples = 2048;
+    static constexpr double hub_factor = 8.0;   // hub: degree above hub_factor * E[d]
+};
+
+// Estimates, level by level, how many candidates a matching order produces
+// when it is started from one update edge, and the work of producing them.
+class ScheduleCostModel {
+public:
+    explicit ScheduleCostModel(const GraphStatistics& stats) : stats(stats) {}
+
+    const GraphStatistics& get_statistics() const { return stats; }
+
+    // candidates[l] for l >= 2: expected size of the level-l candidate set
+    // per partial match of the first l levels. Returns the expected number of
+    // adjacency entries scanned to match the whole order.
+    double estimate(const int* adj, int size, const std::vector<int>& order,
+                    std::vector<double>& candidates) const;
+
+private:
+    GraphStatistics stats;
+};
+
+#endif // COST_MODEL_H
@@ -2,40 +2,83 @@
 #define DAG_H
 
 #include "schedule.h"
+#include "adjacency.h"
 #include <vector>
 #include <memory>
+#include <cstdint>
+
+// One matching step: the earlier levels the vertex matched at this level is
+// adjacent to, and the earlier levels its match must be above or below.
+struct TrieStep {
+    uint64_t parents;
+    uint64_t greater_than;
+    uint64_t less_than;
+
+    bool operator==(const TrieStep& other) const {
+        return parents == other.parents && greater_than == other.greater_than && less_than == other.less_than;
+    }
+};
+
+// Prefix trie of matching orders. Node 0 is level 0, the first endpoint of
+// the update edge; a node at level l stands for the first l + 1 steps of
+// every schedule inserted through it, so schedules that start with the same
+// steps share one node, and one candidate set, per common level.
+class ScheduleTrie {
+public:
+    struct Node {
+        TrieStep step;
+        int level;
+        int parent;
+        std::vector<int> children;
+        size_t schedules;       // schedules passing through the node
+        size_t ends;            // schedules ending at it
+    };
+
+    ScheduleTrie();
+
+    // steps[l] describes level l + 1; returns the node of every level,
+    // starting with the root.
+    std::vector<int> insert(const std::vector<TrieStep>& steps);
+
+    const std::vector<Node>& get_nodes() const { return nodes; }
+    size_t get_steps() const { return steps_inserted; }
+    // steps that landed on an existing node
+    size_t get_merged_steps() const { return steps_inserted - (nodes.size() - 1); }
+
+private:
+    std::vector<Node> nodes;
+    size_t steps_inserted;
+};
 
 class DAG {
 private:
     int size;                   
-    int* adj_matrix;           
+    Adjacency adj;
     std::vector<Schedule> schedules; 
+    ScheduleTrie trie;
 
 public:
     DAG(const std::vector<Schedule>& scheds);
     
-    DAG(const DAG& other);
-
-    ~DAG();
-    
     int get_size() const { return size; }
     
 
-    const int* get_adj_matrix() const { return adj_matrix; }
+    const Adjacency& get_adjacency() const { return adj; }
     const std::vector<Schedule>& get_schedules() const { return schedules; }
+    // schedules merged on the steps of their first matching order
+    const ScheduleTrie& get_trie() const { return trie; }
     
     void print() const;
 
     void build_from_schedules();
 
-    static std::unique_ptr<DAG> DAG_combination(const std::vector<DAG>& dags);
+    // Steps of a schedule matched in the given order; the symmetry
+    // restrictions are left to the match plan.
+    static std::vector<TrieStep> order_steps(const Schedule& schedule, const std::vector<int>& order);
 
-    bool has_overlap(const DAG& other) const;
-
-    std::vector<std::pair<int, int>> get_overlap_vertices(const DAG& other) const;
-
-private:
-    bool is_vertex_similar(int v1, int v2, const DAG& other, int other_v1, int other_v2) const;
+    // All schedules of the DAGs in one DAG, merged in its trie. The DAGs
+    // must describe patterns of the same size.
+    static std::unique_ptr<DAG> DAG_combination(const std::vector<DAG>& dags);
 };
 
 #endif // DAG_H
\ No newline at end of file
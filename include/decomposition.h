@@ -0,0 +1,76 @@
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+#include "cost_model.h"
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+struct MatchView;
+
+// One side of a decomposed schedule: the separator plus the pattern vertices
+// of some of the components left without it, relabeled in matching order so
+// that level l is local vertex l. Levels 0 and 1 are the update edge.
+struct JoinSide {
+    int size;
+    std::vector<int> vertices;                  // pattern vertex at each level
+    std::vector<int> matrix;                    // side adjacency in level order, for the cost model
+    std::vector<std::vector<int>> parents;      // earlier levels adjacent to each level
+    std::vector<int> key_levels;                // level of each separator vertex, in separator order
+    std::vector<int> own_levels;                // levels of the vertices outside the separator
+};
+
+// Partial embeddings of one side around an update edge: the separator
+// mapping of each (the join key) and its own data vertices, sorted.
+struct JoinRelation {
+    int key_size;
+    int own_size;
+    std::vector<int> keys;
+    std::vector<int> owns;
+
+    size_t size() const { return key_size ? keys.size() / key_size : 0; }
+};
+
+// A schedule split at a vertex separator that contains the update edge. Each
+// side is matched on its own around the update edge, without symmetry
+// breaking, and the two relations are hash-joined on the separator mapping.
+// Vertices of the two sides must differ; the join counts the disjoint pairs
+// of a key by inclusion-exclusion over the vertex subsets the sides share,
+// so no pair is enumerated. Every subgraph comes out once per automorphism
+// of the schedule, which the symmetry restrictions of the DFS plan would
+// have broken, so the sum is divided by their number.
+class PatternDecomposition {
+public:
+    // At most this many vertices per side outside the separator: the join
+    // looks up 2^own subsets per tuple.
+    static const int max_own = 5;
+    static const int max_separator = 4;
+
+    // Every split of the schedule (update edge marked 2) at a separator of
+    // the smallest size that has one, with connected sides of at most
+    // max_own own vertices. Empty when the pattern has none.
+    static std::vector<PatternDecomposition> candidates(const int* adj, int size);
+
+    const std::vector<int>& get_separator() const { return separator; }
+    const JoinSide& get_side(int i) const { return sides[i]; }
+    size_t get_automorphisms() const { return automorphisms; }
+
+    // Adjacency entries the two side enumerations are expected to scan per
+    // update edge orientation, plus one unit per subset the join looks up.
+    double estimate(const ScheduleCostModel& model) const;
+
+    size_t count(const std::pair<int, int>& edge, const MatchView& view) const;
+
+private:
+    static bool build_side(const int* adj, int size, const std::vector<int>& separator,
+                           const std::vector<int>& own, JoinSide& side);
+    void enumerate(const JoinSide& side, int a, int b, const MatchView& view, JoinRelation& out) const;
+    static long long join(const JoinRelation& build, const JoinRelation& probe);
+
+    std::vector<int> separator;     // pattern vertices, the update edge first
+    JoinSide sides[2];
+    size_t automorphisms;
+};
+
+#endif // DECOMPOSITION_H
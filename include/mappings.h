@@ -1,21 +1,25 @@
 #pragma once
 
 #include "pattern.h"
+#include "adjacency.h"
 
 #include <vector>
+#include <utility>
 
 class Mappings
 {
 private:
     /* data */
-    int* adj_mat;
+    Adjacency adj;
     int size;
 public:
     Mappings(int _size, char *buffer);
-    ~Mappings();
+    explicit Mappings(Adjacency _adj) : adj(std::move(_adj)), size(adj.get_size()) {}
     void add_edge(int x, int y);
     void del_edge(int x, int y);
     void add_update_mapping(int x, int y);
     void print() const;
-    inline const int* get_adj_mat_ptr() const {return adj_mat;}
+    inline const Adjacency& get_adjacency() const {return adj;}
+    inline int get_size() const {return size;}
+    CanonicalLabeling canonical_form() const { return CanonicalLabeling(adj.to_matrix().data(), size); }
 };
\ No newline at end of file
@@ -0,0 +1,256 @@
+#ifndef MATCH_ENGINE_H
+#define MATCH_ENGINE_H
+
+#include "dag.h"
+#include "update_batch.h"
+#include "cost_model.h"
+#include "decomposition.h"
+#include "sorted_adjacency.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
+#include <utility>
+#include <memory>
+#include <map>
+
+// Common-neighbor sets N(vertex) ∩ N(x) of the endpoint shared by an update
+// group, computed on the batch snapshot and filtered on use. When the group
+// is mined by several threads, each has its own cache over a shared one,
+// filled beforehand and only read, that find() looks in first.
+struct SharedEndpointCache {
+    int vertex;
+    std::unordered_map<int, std::unordered_set<int>> common;
+    const SharedEndpointCache* shared = nullptr;
+
+    const std::unordered_set<int>* find(int other) const {
+        if (shared) {
+            auto it = shared->common.find(other);
+            if (it != shared->common.end()) return &it->second;
+        }
+        auto it = common.find(other);
+        return it != common.end() ? &it->second : nullptr;
+    }
+};
+
+// What one update is mined against: the stored graph, minus the batch edges
+// the timeline hides at this update's index. sorted, when set, holds the
+// same neighborhoods as sorted arrays for the leapfrog kernel.
+struct MatchView {
+    const AdjacencyMap* graph;
+    const EdgeTimeline* timeline;
+    size_t index;
+    SharedEndpointCache* cache;
+    const SortedAdjacency* sorted;
+
+    bool visible(int a, int b) const { return !timeline || timeline->visible(a, b, index); }
+    const std::unordered_set<int>& adjacency(int vertex) const;
+};
+
+// One schedule compiled for execution. Level 0 and 1 hold the endpoints of
+// the update edge; every later level is adjacent to at least one earlier one.
+struct MatchSchedule {
+    std::vector<int> order;                     // pattern vertex matched at each level
+    std::vector<std::vector<int>> parents;      // earlier levels adjacent to the level
+    std::vector<std::vector<int>> less_than;    // earlier levels this level's match must be below
+    std::vector<std::vector<int>> greater_than; // earlier levels this level's match must be above
+    std::vector<double> estimated_candidates;   // cost model: candidate set size per level
+    double estimated_cost;                      // cost model: adjacency entries scanned per root
+    size_t orders_considered;
+};
+
+// One node of the plan's schedule trie compiled for execution: the levels it
+// depends on, as in MatchSchedule, and the schedules sharing its candidates.
+struct MatchStep {
+    std::vector<int> parents;
+    std::vector<int> less_than;
+    std::vector<int> greater_than;
+    std::vector<size_t> schedules;
+};
+
+// Observed counterpart of the estimates: for each (schedule, level), how
+// often its candidate set was needed and how many candidates it held.
+// Schedules sharing a trie node share one intersection, so intersections
+// stays below the sum of expansions by what the trie saved.
+struct MatchProfile {
+    std::vector<size_t> expansions;
+    std::vector<size_t> candidates;
+    size_t intersections = 0;
+
+    void merge(const MatchProfile& other);
+    double mean_candidates(size_t schedule, int level, int size) const;
+};
+
+// How candidate sets are intersected. All kernels produce the same sets;
+// they differ in which parent neighborhood is scanned and in the order the
+// remaining parents and the batch timeline are probed.
+enum class IntersectionKernel {
+    SMALLEST_SCAN = 0,      // scan the smallest parent neighborhood
+    SELECTIVE_PROBE = 1,    // as above, probing smaller neighborhoods and adjacency before visibility
+    LAST_PARENT_SCAN = 2,   // scan the most recently matched parent, no size comparisons
+    LEAPFROG = 3            // leapfrog over the sorted neighborhoods of all parents at once, the
+                            // symmetry restrictions as bounds; needs MatchView::sorted
+};
+
+// Everything that can be tuned about a plan: the matching order of each
+// schedule and the intersection kernel.
+struct MatchConfig {
+    std::vector<std::vector<int>> orders;
+    IntersectionKernel kernel;
+};
+
+// Symmetry-breaking restrictions of one compiled order as level pairs
+// (a, b), meaning the match at level a is below the one at level b.
+typedef std::vector<std::pair<int, int>> Restrictions;
+
+// The part of a plan that depends on the pattern alone: the schedules, the
+// valid orders of each and the restrictions of every order compiled so far,
+// plus the configuration the auto-tuner settled on, if any. A plan built
+// from one skips generate_orders() and the stabilizer searches; PlanCache
+// keeps them across runs.
+struct CompiledPlan {
+    int size;
+    std::vector<std::vector<int>> matrices;                         // schedule adjacency, in DAG order
+    std::vector<std::vector<std::vector<int>>> orders;              // generate_orders() of each schedule
+    std::vector<std::map<std::vector<int>, Restrictions>> restrictions;
+    bool tuned;
+    MatchConfig config;
+};
+
+class MatchPlan {
+public:
+    // With a cost model each schedule runs its cheapest valid order and keeps
+    // the next cheapest ones as alternatives, otherwise it runs the first
+    // order generate_orders() returns. A compiled plan for the same schedules
+    // replaces the order generation and restriction searches.
+    explicit MatchPlan(const DAG& dag, const ScheduleCostModel* model = nullptr, size_t alternatives = 1,
+                       const CompiledPlan* compiled = nullptr);
+
+    // Bumped whenever the schedules, orders or restrictions derived from a
+    // pattern change, so cached CompiledPlans from older builds are ignored.
+    static const int engine_version = 1;
+
+    int get_size() const { return size; }
+    const std::vector<MatchSchedule>& get_schedules() const { return schedules; }
+    const std::vector<std::vector<int>>& get_alternatives(size_t schedule) const { return alternatives[schedule]; }
+    IntersectionKernel get_kernel() const { return kernel; }
+    // The schedules merged on their compiled orders and restrictions; the
+    // engine walks the trie instead of every schedule separately.
+    const ScheduleTrie& get_trie() const { return trie; }
+    const std::vector<MatchStep>& get_steps() const { return steps; }
+
+    // Counts a schedule by joining the matches of two sub-patterns that share
+    // a small vertex separator (see PatternDecomposition) wherever the cost
+    // model expects the join to scan less than the schedule's order; the
+    // other schedules stay in the trie. Needs a cost model. Returns the
+    // number of schedules joined.
+    size_t set_decomposition(bool enabled);
+    // joined schedules, in schedule order, and how each is split
+    const std::vector<size_t>& get_joined() const { return joined; }
+    const std::vector<PatternDecomposition>& get_decompositions() const { return decompositions; }
+
+    MatchConfig get_config() const;
+    // Recompiles the plan; rejects configurations whose orders are not valid
+    // schedules of this plan's pattern.
+    bool configure(const MatchConfig& config);
+
+    // Snapshot for PlanCache; tuned is left false.
+    CompiledPlan get_compiled() const;
+
+    void print(const MatchProfile* profile = nullptr) const;
+
+private:
+    MatchSchedule compile(size_t schedule, const std::vector<int>& order);
+    void build_trie();
+    Restrictions symmetry_restrictions(size_t schedule, const std::vector<int>& order) const;
+    bool is_valid_order(size_t schedule, const std::vector<int>& order) const;
+
+    int size;
+    IntersectionKernel kernel;
+    std::vector<std::vector<int>> matrices;
+    std::vector<std::vector<std::vector<int>>> orders;          // every valid order, as generated
+    std::vector<std::map<std::vector<int>, Restrictions>> restrictions;
+    std::vector<std::vector<std::vector<int>>> alternatives;   // cheapest first
+    std::vector<size_t> orders_considered;
+    std::vector<MatchSchedule> schedules;
+    ScheduleTrie trie;
+    std::vector<MatchStep> steps;                              // per trie node
+    std::vector<size_t> joined;
+    std::vector<PatternDecomposition> decompositions;          // of each joined schedule
+    std::vector<double> join_costs;
+    std::unique_ptr<ScheduleCostModel> model;
+};
+
+// Complete loop state of one update's enumeration. Nothing lives on the C++
+// stack between calls to MatchEngine::resume(), so a cursor can be parked
+// and finished later, possibly by another thread.
+struct MatchCursor {
+    std::pair<int, int> edge;
+    int orientation;
+    int depth;                                  // -1: next orientation not started
+    std::vector<int> mapping;
+    std::vector<int> node;                      // trie node matched at each level
+    std::vector<size_t> child;                  // next child of node[level] to descend into
+    std::vector<std::vector<int>> candidates;
+    std::vector<size_t> position;
+    size_t joins;                               // joined schedules counted, after the trie walk
+    int branch;                                 // root child the walk is confined to, or -1
+    size_t count;
+    bool done;
+    MatchProfile profile;
+    std::vector<const std::unordered_set<int>*> probes;   // scratch of fill_candidates()
+    std::vector<const std::vector<int>*> lists;           // scratch of the leapfrog kernel
+};
+
+class MatchEngine {
+public:
+    explicit MatchEngine(const DAG& dag, const ScheduleCostModel* model = nullptr, size_t alternatives = 1,
+                         const CompiledPlan* compiled = nullptr)
+        : plan(dag, model, alternatives, compiled) {}
+
+    const MatchPlan& get_plan() const { return plan; }
+    // Not safe while other threads are mining with this engine.
+    bool configure(const MatchConfig& config) { return plan.configure(config); }
+    size_t set_decomposition(bool enabled) { return plan.set_decomposition(enabled); }
+
+    MatchCursor start(const std::pair<int, int>& edge) const;
+
+    // Advances the cursor until the enumeration finishes (returns true) or
+    // the deadline passes (returns false, cursor left resumable).
+    bool resume(MatchCursor& cursor, const MatchView& view,
+                std::chrono::steady_clock::time_point deadline =
+                    std::chrono::steady_clock::time_point::max()) const;
+
+    size_t count(const std::pair<int, int>& edge, const MatchView& view, MatchProfile* profile = nullptr) const;
+
+    // The work of count() as independent pieces, which may run on different
+    // threads: every child of the trie root in either orientation of the
+    // update edge, then every joined schedule. The branch counts of an
+    // update add up to its count().
+    size_t branches() const {
+        return 2 * plan.get_trie().get_nodes()[0].children.size() + plan.get_decompositions().size();
+    }
+    size_t count_branch(const std::pair<int, int>& edge, const MatchView& view, size_t branch,
+                        MatchProfile* profile = nullptr) const;
+
+    // Breadth-first counterpart of count(): every trie node is matched for
+    // all partial matches of its parent node at once, sorted by the vertex
+    // whose neighborhood the step scans first and with the neighborhoods a
+    // few matches ahead prefetched. A frontier that would grow past
+    // budget_bytes is extended depth-first in chunks of that size instead.
+    size_t count_frontier(const std::pair<int, int>& edge, const MatchView& view, size_t budget_bytes,
+                          MatchProfile* profile = nullptr) const;
+
+private:
+    void fill_candidates(MatchCursor& cursor, int node, int level, const MatchView& view) const;
+    void leapfrog_candidates(MatchCursor& cursor, const MatchStep& step, int level, const MatchView& view) const;
+    void extend_frontier(MatchCursor& cursor, int node, const std::vector<int>& frontier, size_t limit,
+                         const MatchView& view) const;
+
+    MatchPlan plan;
+
+    static const size_t deadline_check_interval = 256;
+    static const size_t prefetch_distance = 8;
+};
+
+#endif // MATCH_ENGINE_H
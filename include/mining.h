@@ -3,10 +3,32 @@
 
 #include <vector>
 #include <set>
+#include <fstream>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <functional>
 #include "dag.h"
+#include "update_batch.h"
+#include "update_router.h"
+#include "match_engine.h"
+#include "auto_tuner.h"
+#include "sharded_counter.h"
+
+class TaskManager;
+
+// Per-update outcome. In latency SLO mode an update whose mining overran the
+// budget is reported twice: first with the partial count and provisional
+// set, then with the complete count once the deferred work has finished.
+struct UpdateResult {
+    int u;
+    int v;
+    bool is_insert;
+    size_t matches;
+    bool provisional;
+};
 
 class Mining {
 private:
@@ -14,18 +36,87 @@ private:
     std::string graph_file_path;    
     std::string update_file_path;   
     std::unique_ptr<DAG> dag;
-    size_t pattern_count;          
+    ShardedCounter pattern_count;   // added to by every mining thread
+    ShardedCounter removed_count;
+    size_t batch_size;
+    
+    UpdateRouter router;
+    size_t lane_threads[2];
+    LaneStats lane_stats[2];
+    
+    std::unique_ptr<MatchEngine> engine;
+    MatchProfile profile;
+
+    double latency_budget_us;
+    size_t completion_threads;
+    size_t deferred_count;
+    size_t static_count;
+    size_t static_threads;
+    std::function<void(const UpdateResult&)> result_callback;
+    std::ofstream result_file;      // output of run() without the task runtime
+    std::mutex result_mutex;
+
+    std::unique_ptr<MatchConfig> compiled_config;   // tuned configuration of a compiled plan
+    std::unique_ptr<AutoTuner> tuner;
+    std::string tuning_file;
+    size_t tune_check_interval;
+    size_t updates_since_check;
+    bool tuned;
+    TuningReport last_tuning;
+    bool decompose;
+    bool leapfrog;
+    size_t frontier_budget;
+    std::unique_ptr<SortedAdjacency> sorted_graph;  // the graph as sorted arrays, in leapfrog mode
+    size_t runtime_threads;
+    TaskManager* runtime;           // the "mining-<runtime_threads>" pool, with that many customers
+    std::string output_file_path;
+
+    struct BatchContext;
+    struct Pipeline;
     
     std::unordered_set<int> neighborhood(int vertex) const;
-    void process(const std::vector<int>& pattern);
+    const std::unordered_set<int>& adjacency(int vertex) const;
+    const std::unordered_set<int>& common_neighbors(int a, int b, std::unordered_set<int>& scratch,
+                                                    SharedEndpointCache* cache) const;
+    void process(const std::vector<int>& pattern, size_t& count) const;
     
-    void mine_patterns(const std::pair<int, int>& edge);
+    MatchView view_of(const EdgeTimeline* timeline, size_t index, SharedEndpointCache* cache) const {
+        return MatchView{&graph, timeline, index, cache, sorted_graph.get()};
+    }
+    size_t count_matches(const std::pair<int, int>& edge, const MatchView& view, MatchProfile* profile = nullptr) const;
+    size_t mine_patterns(const std::pair<int, int>& edge, const MatchView& ctx) const;
+    void emit(const UpdateResult& result);
+    size_t count_static() const;
+    void tune(const std::vector<EdgeUpdate>& net, const EdgeTimeline& timeline);
+    void run_lanes(const EdgeTimeline& timeline, const std::vector<EndpointGroup>& groups);
+    bool begin_batch(const UpdateBatch& batch, BatchContext& context, UpdateBatch::CompactionStats* stats);
+    void end_batch(BatchContext& context);
+    void start_tasks(BatchContext& context);
+    void finish_tasks(BatchContext& context);
+    void mine_branch(BatchContext& batch, size_t group, size_t branch);
+    void run_pipeline(int update_fd, UpdateBatch::CompactionStats& total);
 
 public:
-    Mining(const std::string& graph_path, const std::string& update_path, std::unique_ptr<DAG>& input_dag) 
-        : graph_file_path(graph_path), update_file_path(update_path), dag(std::move(input_dag)) {}
+    // A compiled plan of the DAG's schedules (see PlanCache) saves the order
+    // generation and symmetry searches and brings its tuned configuration.
+    Mining(const std::string& graph_path, const std::string& update_path, std::unique_ptr<DAG>& input_dag,
+           const CompiledPlan* compiled = nullptr);
     
-    Mining() : pattern_count(0) {}
+    Mining() : pattern_count(0), removed_count(0), batch_size(default_batch_size), lane_threads{1, default_heavy_threads()},
+               latency_budget_us(0), completion_threads(1), deferred_count(0),
+               static_count(0), static_threads(default_static_threads()),
+               tune_check_interval(0), updates_since_check(0), tuned(false), last_tuning{0, 0, 0, 0},
+               decompose(false), leapfrog(false), frontier_budget(0), runtime_threads(0), runtime(nullptr) {}
+
+    static const size_t default_batch_size = 4096;
+    static size_t default_heavy_threads() {
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 1 ? hw - 1 : 1;
+    }
+    static size_t default_static_threads() {
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 0 ? hw : 1;
+    }
     
     void set_graph_file(const std::string& path) { graph_file_path = path; }
     void set_update_file(const std::string& path) { update_file_path = path; }
@@ -35,22 +126,113 @@ public:
     
     void add_node(int node);
     void add_edge(int u, int v);
+    void remove_edge(int u, int v);
     bool has_node(int node) const;
     bool has_edge(int u, int v) const;
     
     void mining(const std::pair<int, int>& edge, bool add_to_graph = true);
+    void unmining(const std::pair<int, int>& edge, bool remove_from_graph = true);
+    
+    void apply_batch(const UpdateBatch& batch, UpdateBatch::CompactionStats* stats = nullptr);
+    void set_batch_size(size_t size) { batch_size = size ? size : 1; }
     
+    // Updates estimated to cost more than heavy_threshold_us are mined in the
+    // heavy lane so they do not delay cheap updates of the same batch.
+    void set_lane_threads(size_t fast, size_t heavy);
+    void set_heavy_threshold(double us) { router.set_heavy_threshold(us); }
+    const LaneStats& get_lane_stats(UpdateLane lane) const { return lane_stats[static_cast<int>(lane)]; }
+    void print_lane_stats() const;
+    
+    // Latency SLO mode: mining of an update stops after budget_us, reports a
+    // provisional count and is completed by completion threads in the
+    // background, which frees the lane thread for the next update. The
+    // batch itself still waits for the completions, since the next batch
+    // changes the graph their cursors walk: the budget bounds the latency
+    // of each provisional result, not that of the batch. Totals are exact
+    // again once the batch has been applied. Requires the DAG engine; 0
+    // disables the mode.
+    void set_latency_budget(double budget_us, size_t background_threads = 1);
+    void set_result_callback(const std::function<void(const UpdateResult&)>& callback) { result_callback = callback; }
+    size_t get_deferred_count() const { return deferred_count; }
+
+    // Schedules chosen by the cost model with their per-level estimates, and
+    // the candidate set sizes observed while mining updates.
+    const MatchPlan* get_match_plan() const { return engine ? &engine->get_plan() : nullptr; }
+    const MatchProfile& get_match_profile() const { return profile; }
+
+    // Auto-tune mode: the first batch times the top_k cheapest orders of each
+    // schedule and every intersection kernel on up to sample_updates updates
+    // and keeps the fastest. Every check_interval updates the graph
+    // statistics are compared with those at tuning time and the plan is
+    // tuned again if they drifted. With a tuning file the chosen
+    // configuration is saved there and picked up by the next initialize().
+    void set_auto_tune(size_t top_k = 3, size_t sample_updates = 256, size_t check_interval = 65536);
+    void set_tuning_file(const std::string& path) { tuning_file = path; }
+    const TuningReport& get_last_tuning() const { return last_tuning; }
+    // The plan as it stands, including every order compiled so far and the
+    // tuned configuration once there is one; false without a DAG engine.
+    bool get_compiled_plan(CompiledPlan& plan) const;
+    
+    // Decomposition mode: initialize() lets the cost model replace schedules
+    // that split at a small vertex separator by a join of the two sides'
+    // matches (see PatternDecomposition) where the join is cheaper.
+    void set_decomposition(bool enabled) { decompose = enabled; }
+
+    // Leapfrog mode: the graph is also kept as sorted neighborhood arrays,
+    // built by initialize() and updated with every edge, and the plan starts
+    // with the leapfrog kernel, which intersects the neighborhoods of all
+    // parents of a level in one worst-case optimal pass. Suits cyclic,
+    // densely closed patterns; auto-tuning may still pick another kernel.
+    void set_leapfrog(bool enabled) { leapfrog = enabled; }
+
+    // Frontier mode: updates outside the latency SLO mode are mined
+    // breadth-first by MatchEngine::count_frontier(), holding at most about
+    // budget_bytes of partial matches per trie level; 0 mines depth-first.
+    void set_frontier_budget(size_t budget_bytes) { frontier_budget = budget_bytes; }
+    
+    // Task runtime mode: run() reads updates, mines batches and writes
+    // results as three pipeline stages on a TaskManager pool of exactly
+    // threads workers, "mining-<threads>", which instances asking for the
+    // same count share. The stages are joined by channels of read_ahead
+    // batches, so reading a file or pipe overlaps with mining and no stage
+    // has a thread of its own; a stage waiting on its descriptor is left
+    // with the Reactor. Batches are cut as in the serial path, and their
+    // results are written in net-update order, as there. Every batch is
+    // split into tasks, one per endpoint group and branch of the match plan
+    // (MatchEngine::count_branch()); groups of the fast lane run before
+    // those of the heavy lane. Not used in latency SLO mode; frontier mode
+    // does not apply to the tasks. 0 mines with threads of its own per
+    // batch.
+    void set_threads(size_t threads);
+    static const size_t read_ahead = 2;
+
+    // run() writes the final count of every net update to this file, one
+    // "<+|-> <u> <v> <matches>" line each, batch by batch in net-update
+    // order; empty writes nothing. The result callback instead sees each
+    // count as soon as it is known.
+    void set_output_file(const std::string& path) { output_file_path = path; }
+
+    // initialize() counts every match of the loaded graph with this many
+    // threads and seeds pattern_count with it; 0 skips the static pass.
+    void set_static_threads(size_t threads) { static_threads = threads; }
+    size_t get_static_count() const { return static_count; }
+
     bool initialize(); 
     void run();       
     
     size_t node_count() const { return graph.size(); }
     size_t edge_count() const;
     
-    void clear() { graph.clear(); }
+    void clear() {
+        graph.clear();
+        if (sorted_graph) sorted_graph->clear();
+    }
 
-    size_t get_pattern_count() const { return pattern_count; }
+    size_t get_pattern_count() const { return pattern_count.get(); }
+    size_t get_removed_count() const { return removed_count.get(); }
+    size_t get_total_count() const { return pattern_count.get() - removed_count.get(); }
     
-    void reset_count() { pattern_count = 0; }
+    void reset_count() { pattern_count.set(0); removed_count.set(0); deferred_count = 0; }
 };
 
 #endif // MINING_H
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <set>
 #include <vector>
 #include <cstdio>
+#include "canonical.h"
+#include "adjacency.h"
 
 #ifndef INDEX
 #define INDEX(x,y,n) ((x)*(n)+(y))
@@ -23,22 +25,21 @@ class Pattern
 public:
     Pattern(int _size, bool clique = false);
     Pattern(int _size, char* buffer);
-    ~Pattern();
-    Pattern(const Pattern& p);
+    Pattern(const Pattern& p) = default;
     Pattern(PatternType type);
     void add_edge(int x, int y);
     void del_edge(int x, int y);
-    inline void add_ordered_edge(int x, int y) { adj_mat[INDEX(x, y, size)] = 1;}
+    inline void add_ordered_edge(int x, int y) { adj.set(x, y, 1);}
     inline int get_size() const {return size;}
-    inline const int* get_adj_mat_ptr() const {return adj_mat;}
+    inline const Adjacency& get_adjacency() const {return adj;}
     bool check_connected() const;
     void count_all_isomorphism(std::set< std::set<int> >& s) const;
     std::vector< std::vector<int> > get_isomorphism_vec() const;
+    CanonicalLabeling canonical_form() const { return CanonicalLabeling(adj.to_matrix().data(), size); }
     void print() const;
     bool is_dag() const;
 private:
     Pattern& operator =(const Pattern&);
-    void get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const;
-    int* adj_mat;
+    Adjacency adj;
     int size;
 };
@@ -3,6 +3,7 @@
 
 #include "dag.h"
 #include "execution_planner.h"
+#include "task_manager.h"
 #include <vector>
 #include <string>
 #include <chrono>
@@ -25,6 +26,7 @@ public:
         std::vector<std::string> bottlenecks;
         std::vector<std::string> optimization_suggestions;
         std::map<int, std::vector<double>> vertex_metrics;
+        std::vector<WorkerStats> worker_stats;      // of the monitored pool, since startMonitoring()
     };
 
     struct MonitoringConfig {
@@ -46,6 +48,8 @@ public:
     void recordMetric(const std::string& metric_name, double value);
     void recordVertexExecution(int vertex_id, const PerformanceMetrics& metrics);
     void markEventTimestamp(const std::string& event_name);
+    // Reports include what the workers of pool did while monitoring.
+    void monitorTaskManager(const TaskManager& pool);
 
     PerformanceReport generateReport() const;
     std::vector<std::string> analyzeBottlenecks() const;
@@ -77,6 +81,8 @@ private:
     std::vector<PerformanceMetrics> metrics_history_;
     std::map<std::string, std::chrono::steady_clock::time_point> event_timestamps_;
     std::map<int, std::vector<PerformanceMetrics>> vertex_metrics_;
+    const TaskManager* task_manager_;
+    std::vector<WorkerStats> worker_baseline_;
 
     void updateMetrics();
     double calculateAggregateMetric(const std::string& metric_name) const;
@@ -84,6 +90,7 @@ private:
     void cleanupStaleData();
     bool isResourceOverutilized(const std::string& resource_type) const;
     std::vector<std::pair<int, int>> findConcurrentExecutions() const;
+    std::vector<WorkerStats> collectWorkerStats() const;
 };
 
 #endif // PERFORMANCE_ANALYZER_H 
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include "pattern.h"
+#include "match_engine.h"
+#include <string>
+
+// Directory of CompiledPlans, one file per pattern named after its canonical
+// hash and MatchPlan::engine_version. Isomorphic patterns share an entry: the
+// schedules count the same subgraphs whatever the input labeling. The file
+// repeats the canonical matrix, so a hash collision reads as a miss.
+class PlanCache {
+public:
+    explicit PlanCache(const std::string& directory) : directory(directory) {}
+
+    std::string path_for(const Pattern& pattern) const;
+
+    bool load(const Pattern& pattern, CompiledPlan& plan) const;
+    // Written to a temporary file and renamed into place, so concurrent jobs
+    // never read a partial entry.
+    bool store(const Pattern& pattern, const CompiledPlan& plan) const;
+
+private:
+    std::string directory;
+};
+
+#endif // PLAN_CACHE_H
@@ -2,25 +2,38 @@
 
 #include "pattern.h"
 #include "mappings.h"
+#include "adjacency.h"
 #include <vector>
+#include <utility>
 
 class Schedule
 {
 public:
     Schedule(std::vector<Mappings> &mappings, std::vector<bool> &is_unique);
     Schedule(const int* _adj_mat, int _size);
-    ~Schedule();
+    explicit Schedule(Adjacency _adj) : adj(std::move(_adj)), size(adj.get_size()) {}
     void print_schedule() const;
     void add_edge(int x, int y);
     void del_edge(int x, int y);
     void add_update_mapping(int x, int y);
-    void generate_schedules(int *reorderschedule) const;
+    // The schedule relabeled so that the update edge starts at vertex 0.
+    Schedule generate_schedules() const;
+    // Every matching order starting at the update edge (the edge marked 2)
+    // in which each vertex is adjacent to the prefix (rule 1) and has the
+    // most edges into it among the remaining vertices (rule 2).
+    std::vector< std::vector<int> > generate_orders() const;
+    // generate_orders().front(), without enumerating the others; empty if
+    // the schedule has no update edge or is not connected.
+    std::vector<int> first_order() const;
     
-    const int* get_adj_matrix() const { return adj_mat; }
+    const Adjacency& get_adjacency() const { return adj; }
     int get_size() const { return size; }
+    CanonicalLabeling canonical_form() const { return CanonicalLabeling(adj.to_matrix().data(), size); }
 
 private:
-    int* adj_mat;
+    Adjacency adj;
     int size;
-    void get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const;
+    bool find_update_edge(int& x, int& y) const;
+    void extend_orders(std::vector<int>& order, std::vector<int>& links, std::vector<bool>& placed,
+                       std::vector< std::vector<int> >& orders) const;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+
+// A count that many threads add to at once. Every thread adds to its own
+// shard on its own cache line, so writers do not contend; get() reduces
+// the shards and is exact once the writers are done.
+class ShardedCounter {
+public:
+    static const size_t shards = 128;
+
+    explicit ShardedCounter(size_t value = 0) { set(value); }
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+    void add(size_t value) { cells[shard()].value.fetch_add(value, std::memory_order_relaxed); }
+
+    size_t get() const {
+        size_t total = 0;
+        for (size_t i = 0; i < shards; ++i) total += cells[i].value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Not safe while other threads add.
+    void set(size_t value) {
+        for (size_t i = 0; i < shards; ++i) cells[i].value.store(0, std::memory_order_relaxed);
+        cells[0].value.store(value, std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> value;
+        char padding[64 - sizeof(std::atomic<size_t>)];
+    };
+
+    // threads are numbered in the order they first add to any counter
+    static size_t shard() {
+        static std::atomic<size_t> threads(0);
+        thread_local size_t index = threads.fetch_add(1, std::memory_order_relaxed) % shards;
+        return index;
+    }
+
+    Cell cells[shards];
+};
+
+#endif // SHARDED_COUNTER_H
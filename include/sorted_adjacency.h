@@ -0,0 +1,34 @@
+#ifndef SORTED_ADJACENCY_H
+#define SORTED_ADJACENCY_H
+
+#include "cost_model.h"
+#include <vector>
+#include <unordered_map>
+#include <climits>
+
+// Every neighborhood of the data graph as a sorted array, kept next to the
+// hash sets of Mining for the leapfrog kernel. Insertions and deletions keep
+// the arrays sorted, so they cost O(degree).
+class SortedAdjacency {
+public:
+    SortedAdjacency() = default;
+    explicit SortedAdjacency(const AdjacencyMap& graph);
+
+    void add_edge(int u, int v);
+    void remove_edge(int u, int v);
+    void clear() { lists.clear(); }
+
+    const std::vector<int>& neighbors(int vertex) const;
+
+    // Leapfrog intersection of sorted lists, restricted to values in
+    // [lower, upper): every list seeks, by galloping, to the largest value
+    // the others are at, and a value all of them reach is appended to out.
+    // Work is bounded by the smallest list times the log of the others.
+    static void intersect(const std::vector<const std::vector<int>*>& lists, std::vector<int>& out,
+                          int lower = INT_MIN, int upper = INT_MAX);
+
+private:
+    std::unordered_map<int, std::vector<int>> lists;
+};
+
+#endif // SORTED_ADJACENCY_H
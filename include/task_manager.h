@@ -10,8 +10,11 @@
 #include <memory>
 #include <atomic>
 #include <string>
+#include <map>
 #include <deque>
-#include <omp.h>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 class Task {
 public:
@@ -30,56 +33,369 @@ private:
     int task_priority;
 };
 
-class WorkQueue {
+// Work-stealing deque of Chase and Lev, in the C11 formulation of Le et al.
+// The owning worker pushes and pops at the bottom without locks; any other
+// thread steals from the top with one CAS. The circular buffer doubles when
+// full; buffers it outgrew stay alive until the deque is destroyed, since a
+// thief may still be reading one. T must be trivially copyable.
+template <typename T>
+class ChaseLevDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "deque elements are copied bitwise");
+
 public:
-    WorkQueue() : size(0) {}
-    
-    bool push(std::shared_ptr<Task> task) {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        if (size >= max_size) return false;
-        task_queue.push_back(task);
-        size++;
+    explicit ChaseLevDeque(size_t capacity = 64) : top(0), bottom(0) {
+        size_t c = 1;
+        while (c < capacity) c <<= 1;
+        buffers.emplace_back(new Buffer(c));
+        buffer.store(buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    // owner only
+    void push(const T& value) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(a->mask)) {
+            a = grow(a, t, b);
+        }
+        a->put(b, value);
+        bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // owner only; newest element first
+    bool pop(T& value) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* a = buffer.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        value = a->get(b);
+        if (t == b) {
+            // last element: race the thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
         return true;
     }
-    
-    std::shared_ptr<Task> pop() {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        if (task_queue.empty()) return nullptr;
-        auto task = task_queue.front();
-        task_queue.pop_front();
-        size--;
-        return task;
+
+    // any thread; oldest element first. Fails when empty or when another
+    // thread took the element first.
+    bool steal(T& value) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return false;
+        Buffer* a = buffer.load(std::memory_order_acquire);
+        value = a->get(t);
+        return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
     }
-    
-    std::shared_ptr<Task> steal() {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        if (task_queue.empty()) return nullptr;
-        auto task = task_queue.back();
-        task_queue.pop_back();
-        size--;
+
+    size_t getSize() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    // Slots are runs of relaxed atomic words, so a T of any size is read and
+    // written without a lock. A thief may read a torn element while the
+    // owner overwrites the slot, but only when its CAS on top then fails.
+    static const size_t words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    struct Buffer {
+        explicit Buffer(size_t capacity) : mask(capacity - 1), slots(new std::atomic<uint64_t>[capacity * words]) {}
+        T get(int64_t i) const {
+            const std::atomic<uint64_t>* slot = &slots[(i & mask) * words];
+            uint64_t raw[words];
+            for (size_t w = 0; w < words; ++w) raw[w] = slot[w].load(std::memory_order_relaxed);
+            T value;
+            std::memcpy(&value, raw, sizeof(T));
+            return value;
+        }
+        void put(int64_t i, const T& value) {
+            std::atomic<uint64_t>* slot = &slots[(i & mask) * words];
+            uint64_t raw[words] = {};
+            std::memcpy(raw, &value, sizeof(T));
+            for (size_t w = 0; w < words; ++w) slot[w].store(raw[w], std::memory_order_relaxed);
+        }
+
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    Buffer* grow(Buffer* a, int64_t t, int64_t b) {
+        buffers.emplace_back(new Buffer(2 * (a->mask + 1)));
+        Buffer* bigger = buffers.back().get();
+        for (int64_t i = t; i < b; ++i) bigger->put(i, a->get(i));
+        buffer.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // top and bottom on separate cache lines: thieves write one, the owner the other
+    std::atomic<int64_t> top;
+    char top_padding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> bottom;
+    char bottom_padding[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<Buffer*> buffer;
+    std::vector<std::unique_ptr<Buffer>> buffers;   // owner only
+};
+
+// Bounded lock-free queue for any number of producers and consumers
+// (Vyukov): a slot's sequence number says whether it is free for the push,
+// or filled for the pop, of the current lap around the ring.
+template <typename T>
+class InjectionQueue {
+public:
+    explicit InjectionQueue(size_t capacity) : head(0), tail(0) {
+        size_t c = 2;
+        while (c < capacity) c <<= 1;
+        mask = c - 1;
+        slots.reset(new Slot[c]);
+        for (size_t i = 0; i < c; ++i) slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const T& value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // full
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& value) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = slot.value;
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // empty
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t getSize() const {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_relaxed);
+        return t > h ? t - h : 0;
+    }
+    size_t getCapacity() const { return mask + 1; }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    std::atomic<size_t> head;
+    char head_padding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+};
+
+// A task held by value: a small callable, typically a lambda whose captures
+// are a vertex range, a DAG node id or a pointer to shared state, copied
+// into inline storage. Queues store these directly, so submitting one
+// allocates nothing. The callable must be trivially copyable and fit in
+// inline_bytes. The priority follows Task::getPriority(): 0 is normal,
+// above is urgent, below is background work.
+class TaskItem {
+public:
+    static const size_t inline_bytes = 48;
+
+    TaskItem() : invoke(nullptr), priority(0) {}
+
+    template <typename F>
+    static TaskItem make(const F& callable, int priority = 0) {
+        static_assert(std::is_trivially_copyable<F>::value, "task callables are copied bitwise");
+        static_assert(sizeof(F) <= inline_bytes, "task callable does not fit in a TaskItem");
+        static_assert(alignof(F) <= alignof(uint64_t), "task callable is over-aligned");
+        TaskItem item;
+        item.invoke = &call<F>;
+        item.priority = priority;
+        std::memcpy(item.storage, &callable, sizeof(F));
+        return item;
+    }
+
+    void run() const { invoke(storage); }
+    bool empty() const { return invoke == nullptr; }
+    int getPriority() const { return priority; }
+
+private:
+    template <typename F>
+    static void call(const void* storage) { (*static_cast<const F*>(storage))(); }
+
+    void (*invoke)(const void*);
+    alignas(uint64_t) unsigned char storage[inline_bytes];
+    int priority;
+};
+
+// How a worker chooses between its priority lanes: STRICT always runs the
+// most urgent task it has, WEIGHTED gives each lane a share of its turns
+// (16:4:1 from urgent to background) so background work cannot starve.
+enum LanePolicy { STRICT, WEIGHTED };
+
+// Fixed set of slots for string Tasks, so the adapter that queues one as a
+// TaskItem only has to carry a slot index. Any thread takes and returns
+// slots through a lock-free free list; nothing is allocated after
+// construction.
+class TaskPool {
+public:
+    explicit TaskPool(size_t capacity) : slots(capacity), free_slots(capacity) {
+        for (uint32_t i = 0; i < capacity; ++i) free_slots.push(i);
+    }
+
+    // false when every slot is in use
+    bool put(std::shared_ptr<Task> task, uint32_t& index) {
+        if (!free_slots.pop(index)) return false;
+        slots[index] = std::move(task);
+        return true;
+    }
+
+    std::shared_ptr<Task> take(uint32_t index) {
+        std::shared_ptr<Task> task = std::move(slots[index]);
+        free_slots.push(index);
         return task;
     }
-    
-    bool empty() const {
-        std::lock_guard<std::mutex> lock(queue_mutex);
-        return task_queue.empty();
+
+private:
+    std::vector<std::shared_ptr<Task>> slots;
+    InjectionQueue<uint32_t> free_slots;
+};
+
+// Tasks of one worker, in one lane per priority level. Other threads submit
+// into the bounded inbox of a lane; the owner moves them into that lane's
+// Chase-Lev deque in small batches and runs them from there, and thieves
+// steal from the deque first, then from the inbox. Neither path takes a
+// lock.
+class WorkQueue {
+public:
+    static const size_t default_capacity = 1000;    // per lane
+    static const int lanes = 3;                     // background, normal, urgent
+
+    explicit WorkQueue(size_t capacity = default_capacity) : policy(STRICT), turn(0) {
+        for (int l = 0; l < lanes; ++l) inboxes[l].reset(new InjectionQueue<TaskItem>(capacity));
     }
-    
+
+    static int laneOf(int priority) { return priority < 0 ? 0 : priority == 0 ? 1 : 2; }
+
+    // any thread; false when the task's lane is full. The bound is the lane
+    // capacity rounded up to a power of two.
+    bool push(const TaskItem& task) { return inboxes[laneOf(task.getPriority())]->push(task); }
+
+    // owner only: straight into the deque, where it runs next, under the
+    // same bound
+    bool pushLocal(const TaskItem& task) {
+        int lane = laneOf(task.getPriority());
+        if (getSize(lane) >= inboxes[lane]->getCapacity()) return false;
+        deques[lane].push(task);
+        return true;
+    }
+
+    // owner only
+    bool pop(TaskItem& task) {
+        int first = lanes;
+        if (policy.load(std::memory_order_relaxed) == WEIGHTED) {
+            // lane l owns 4^l of every 21 turns
+            unsigned t = turn++ % 21;
+            first = lanes - 1;
+            while (t >= (1u << (2 * first))) t -= 1u << (2 * first--);
+            if (pop(first, task)) return true;
+        }
+        for (int l = lanes - 1; l >= 0; --l) {
+            if (l != first && pop(l, task)) return true;
+        }
+        return false;
+    }
+
+    // any thread
+    bool steal(int lane, TaskItem& task) { return deques[lane].steal(task) || inboxes[lane]->pop(task); }
+
+    void setPolicy(LanePolicy value) { policy.store(value, std::memory_order_relaxed); }
+
+    bool empty() const { return getSize() == 0; }
     size_t getSize() const {
-        std::lock_guard<std::mutex> lock(queue_mutex);
+        size_t size = 0;
+        for (int l = 0; l < lanes; ++l) size += getSize(l);
         return size;
     }
+    size_t getSize(int lane) const { return deques[lane].getSize() + inboxes[lane]->getSize(); }
 
 private:
-    std::deque<std::shared_ptr<Task>> task_queue;
-    mutable std::mutex queue_mutex;
-    size_t size;
-    static const size_t max_size = 1000;
+    bool pop(int lane, TaskItem& task) {
+        if (deques[lane].pop(task)) return true;
+        if (!inboxes[lane]->pop(task)) return false;
+        for (size_t i = 1; i < refill_batch; ++i) {
+            TaskItem more;
+            if (!inboxes[lane]->pop(more)) break;
+            deques[lane].push(more);
+        }
+        return true;
+    }
+
+    ChaseLevDeque<TaskItem> deques[lanes];
+    std::unique_ptr<InjectionQueue<TaskItem>> inboxes[lanes];
+    std::atomic<LanePolicy> policy;
+    unsigned turn;                          // owner only
+    static const size_t refill_batch = 16;
+};
+
+class TaskManager;
+
+// What one worker has done since it started, as of a snapshot. The counters
+// only grow, so the work between two snapshots is their difference. Busy
+// time covers runs of tasks found back to back, including the one under way.
+struct WorkerStats {
+    static const int depth_buckets = 12;
+
+    std::string id;
+    int cpu;
+    int node;
+    uint64_t tasks_executed;
+    uint64_t steals;            // tasks taken from other customers
+    uint64_t failed_steals;     // searches of the other customers that found nothing
+    double busy_ms;
+    double parked_ms;
+    // Own queue depth, sampled every few tasks: bucket 0 counts an empty
+    // queue, bucket b depths from 2^(b-1) to 2^b - 1, the last one the rest.
+    uint64_t queue_depth[depth_buckets];
+
+    WorkerStats since(const WorkerStats& earlier) const;
 };
 
 class Customer {
 public:
-    Customer(const std::string& id) : customer_id(id), is_running(false), work_queue(new WorkQueue()) {}
+    // capacity bounds each priority lane of the customer's queue
+    Customer(const std::string& id, size_t capacity = WorkQueue::default_capacity)
+        : customer_id(id), is_running(false), parked(false), work_queue(new WorkQueue(capacity)),
+          task_pool(WorkQueue::lanes * capacity), manager(nullptr), cpu(-1), node(0), scratch_size(0),
+          counters() {}
     virtual ~Customer() { stop(); }
 
     void start();
@@ -87,41 +403,132 @@ public:
     bool isRunning() const { return is_running; }
     std::string getId() const { return customer_id; }
     
-    bool addTask(std::shared_ptr<Task> task) {
-        return work_queue->push(task);
-    }
+    // From this customer's own worker the task goes to the front of its
+    // deque; from any other thread into its inbox.
+    bool addTask(const TaskItem& task);
+
+    // String tasks are parked in this customer's TaskPool and queued as a
+    // TaskItem that hands them to processTask of whichever customer runs it.
+    bool addTask(std::shared_ptr<Task> task);
     
-    std::shared_ptr<Task> getTask() {
-        return work_queue->pop();
+    bool getTask(TaskItem& task) {
+        return work_queue->pop(task);
     }
     
-    std::shared_ptr<Task> stealTask() {
-        return work_queue->steal();
+    // takes the oldest task of a lane
+    bool stealTask(int lane, TaskItem& task) {
+        return work_queue->steal(lane, task);
     }
     
     bool hasWork() const {
         return !work_queue->empty();
     }
 
+    size_t getLoad() const {
+        return work_queue->getSize();
+    }
+
+    size_t getLoad(int lane) const {
+        return work_queue->getSize(lane);
+    }
+
+    void setLanePolicy(LanePolicy policy) { work_queue->setPolicy(policy); }
+
+    // Unparks the worker if it is parked; true if it was. Call after the
+    // task it should see has been queued.
+    bool wake();
+    bool isParked() const { return parked.load(std::memory_order_relaxed); }
+
+    // The customer whose worker thread is calling, or null off the pool.
+    static Customer* current();
+
+    // Runs a task on the calling thread, which must be this customer's worker.
+    void runInline(const TaskItem& task) { task.run(); }
+    void runInline(const std::shared_ptr<Task>& task) { processTask(*task); }
+
+    // Set by TaskManager::addCustomer before the worker starts; a customer
+    // started on its own belongs to the default pool and is not pinned.
+    void place(TaskManager* pool, int cpu_id, int node_id) {
+        manager = pool;
+        cpu = cpu_id;
+        node = node_id;
+    }
+    bool isPlaced() const { return manager != nullptr; }
+    TaskManager& getManager() const;
+    int getCpu() const { return cpu; }
+    int getNode() const { return node; }
+
+    // Worker thread only: at least bytes of zeroed memory owned by this
+    // worker, allocated and first touched by the worker itself after it was
+    // pinned, so the kernel places it on the worker's NUMA node. Growing it
+    // discards the contents.
+    void* getScratch(size_t bytes);
+
+    // Any thread, at any time; the worker does not stop for it.
+    WorkerStats getStats() const;
+
 protected:
     virtual void processTask(const Task& task) = 0;
 
 private:
+    struct PooledTask {
+        TaskPool* pool;
+        uint32_t index;
+        void operator()() const;
+    };
+
+    // Written by the worker alone, with a plain load and store instead of a
+    // read-modify-write; read by getStats() from any thread.
+    struct Counters {
+        std::atomic<uint64_t> tasks_executed;
+        std::atomic<uint64_t> steals;
+        std::atomic<uint64_t> failed_steals;
+        std::atomic<uint64_t> busy_ns;
+        std::atomic<uint64_t> parked_ns;
+        std::atomic<int64_t> busy_since;        // steady clock ns, 0 when not busy
+        std::atomic<int64_t> parked_since;      // 0 when not parked
+        std::atomic<uint64_t> queue_depth[WorkerStats::depth_buckets];
+    };
+
+    static void count(std::atomic<uint64_t>& counter, uint64_t amount = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
     void run();
+    void park();
+    void sampleDepth();
+
+    // An idle worker retries its queue and stealing this many times before
+    // it parks.
+    static const size_t spin_rounds = 64;
+    // The worker samples its queue depth once per this many tasks.
+    static const uint64_t depth_sample_interval = 16;
 
     std::string customer_id;
     std::atomic<bool> is_running;
+    std::atomic<bool> parked;
+    std::mutex park_mutex;
+    std::condition_variable park_cv;
     std::thread worker_thread;
     std::shared_ptr<WorkQueue> work_queue;
+    TaskPool task_pool;
+
+    TaskManager* manager;
+    int cpu;                    // -1 when not pinned
+    int node;
+    std::unique_ptr<uint64_t[]> scratch;
+    size_t scratch_size;        // bytes
+    Counters counters;
 };
 
 
 class Producer {
 public:
-    Producer(const std::string& id) : producer_id(id) {}
+    // submits to the default pool unless given another
+    Producer(const std::string& id, TaskManager* pool = nullptr) : producer_id(id), manager(pool) {}
     virtual ~Producer() = default;
 
-    void submitTask(std::shared_ptr<Task> task);
+    bool submitTask(std::shared_ptr<Task> task);
     std::string getId() const { return producer_id; }
 
 protected:
@@ -129,44 +536,265 @@ protected:
 
 private:
     std::string producer_id;
+    TaskManager* manager;
 };
 
+// What submitTask does when the chosen customer's lane is full: BLOCK waits
+// until a worker makes room, SPILL moves the task to a bounded global
+// overflow queue that idle workers drain (and blocks when that is full as
+// well), SHED drops it and counts it.
+enum OverflowPolicy { BLOCK, SPILL, SHED };
+
 class TaskManager {
 public:
-    static TaskManager& getInstance() {
-        static TaskManager instance;
-        return instance;
-    }
+    // The default pool.
+    static TaskManager& getInstance() { return getPool("default"); }
+
+    // A pool by name, created on first use. Pools live until the process
+    // exits; each has its own customers, placement and policies.
+    static TaskManager& getPool(const std::string& name);
+
+    const std::string& getName() const { return pool_name; }
 
     void start();
     void stop();
+    // Fails when the customer already belongs to a pool.
     void addCustomer(std::shared_ptr<Customer> customer);
+
+    // Pins customers added from now on to the CPUs in cpus, or to all the
+    // process may run on when it is empty, one customer per CPU in turn:
+    // one hardware thread of every physical core first, node by node, then
+    // the SMT siblings, unless smt is false. Thieves try customers on
+    // their own NUMA node before the others.
+    void setCpuSet(const std::vector<int>& cpus = std::vector<int>(), bool smt = true);
     void addProducer(std::shared_ptr<Producer> producer);
-    void submitTask(std::shared_ptr<Task> task);
+    // A worker submits to its own queue and leaves spreading the work to
+    // thieves; any other thread to the less loaded of two random customers.
+    // Neither takes a lock unless the queue is full. False only when the
+    // task was shed, or there are no customers.
+    bool submitTask(std::shared_ptr<Task> task);
+    bool submitTask(const TaskItem& task);
+
+    void setOverflowPolicy(OverflowPolicy policy, size_t overflow_capacity = 10000);
+    size_t getShedCount() const { return shed_tasks.load(std::memory_order_relaxed); }
+    size_t getOverflowSize() const { return overflow_size.load(std::memory_order_relaxed); }
+
+    // Called by a worker that took a task off its queue: wakes producers
+    // blocked on a full queue.
+    void notifySpace() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (blocked_producers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(space_mutex);
+            space_cv.notify_all();
+        }
+    }
+
+    // Oldest spilled task, if any; a string task comes back in spilled.
+    bool takeOverflow(TaskItem& task, std::shared_ptr<Task>& spilled);
+
+    // Most urgent lane first: a thief takes background work only when no
+    // other customer has anything more urgent queued.
+    bool tryStealTask(const Customer& thief, TaskItem& task);
+
+    // Wakes one parked customer other than busy, so queued work does not
+    // wait for a busy owner while others sleep.
+    void wakeIdle(const Customer* busy);
+    void notifyParked(int delta) { parked_customers.fetch_add(delta, std::memory_order_relaxed); }
+
+    // Applies to every customer, present and future.
+    void setLanePolicy(LanePolicy policy);
 
-    std::shared_ptr<Task> tryStealTask(const Customer& thief);
-    void balanceLoad();
+    // One snapshot per customer, in the order they were added.
+    std::vector<WorkerStats> getStats() const;
 
 private:
-    TaskManager() = default;
+    explicit TaskManager(const std::string& name)
+        : pool_name(name), next_slot(0), customer_count(0), lane_policy(STRICT), is_running(false), parked_customers(0),
+          overflow_policy(BLOCK), overflow_capacity(10000), overflow_size(0), shed_tasks(0),
+          blocked_producers(0) {}
     ~TaskManager();
     TaskManager(const TaskManager&) = delete;
     TaskManager& operator=(const TaskManager&) = delete;
 
-    void dispatchTasks();
     std::shared_ptr<Customer> getAvailableCustomer();
-    void scheduleTask(std::shared_ptr<Task> task);
+    Customer* selectCustomer();     // power of two choices
+    void taskQueued(Customer* target);
+    template <typename T>
+    bool submit(const T& task);
+    bool spill(const TaskItem& task, const std::shared_ptr<Task>& spilled);
 
+    struct Registry {
+        ~Registry();
+        std::mutex mutex;
+        std::map<std::string, TaskManager*> pools;
+    };
+
+    struct Slot {
+        int cpu;
+        int node;
+    };
+
+    std::string pool_name;
     std::vector<std::shared_ptr<Customer>> customers;
     std::vector<std::shared_ptr<Producer>> producers;
+    std::vector<Slot> placement;            // under customer_mutex; empty when unpinned
+    size_t next_slot;
+
+    // customers as thieves see them: slots are written once, under
+    // customer_mutex, before customer_count is raised past them
+    static const size_t max_customers = 256;
+    std::atomic<Customer*> workers[max_customers];
+    std::atomic<size_t> customer_count;
+    LanePolicy lane_policy;                 // under customer_mutex
     
     std::mutex customer_mutex;
     std::atomic<bool> is_running;
-    std::thread dispatcher_thread;
+    std::atomic<int> parked_customers;
+
+    struct Spilled {
+        TaskItem item;
+        std::shared_ptr<Task> task;     // set for a string task
+    };
+    std::atomic<OverflowPolicy> overflow_policy;
+    size_t overflow_capacity;           // under overflow_mutex
+    std::deque<Spilled> overflow;
+    std::mutex overflow_mutex;
+    std::atomic<size_t> overflow_size;
+    std::atomic<size_t> shed_tasks;
+
+    std::atomic<int> blocked_producers;
+    std::mutex space_mutex;
+    std::condition_variable space_cv;      // producers blocked on a full queue
 
-    std::atomic<size_t> total_tasks;
-    static const size_t load_balance_threshold = 100;
     static const size_t max_steal_attempts = 3;
 };
 
+// One thread that waits on file descriptors for every pool: watch() hands
+// it a task to submit once poll() reports fd ready for events (or hung up,
+// or in error), so nothing that waits on I/O holds a worker. A watch fires
+// once; the task re-registers if it finds the descriptor not ready again.
+class Reactor {
+public:
+    static Reactor& getInstance();
+
+    void watch(int fd, short events, TaskManager& pool, const TaskItem& task);
+
+private:
+    Reactor();
+    ~Reactor();
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    void run();
+
+    struct Watch {
+        int fd;
+        short events;
+        TaskManager* pool;
+        TaskItem task;
+    };
+    std::mutex mutex;
+    std::vector<Watch> watches;     // under mutex; only run() removes
+    bool stopping;                  // under mutex
+    int wake_pipe[2];               // interrupts poll() for a new watch
+    std::thread thread;
+};
+
+// A stage of a pipeline on a TaskManager pool, written the way a stackless
+// coroutine would compile: resume() runs from the state the stage left off
+// in until it has to wait, and it waits by handing resumeTask() to whatever
+// will wake it (a Channel, the Reactor, or the last of the tasks it
+// spawned) and returning. A stage holds no thread while it waits, and is never resumed
+// twice at once as long as it returns right after handing its task over.
+class Stage {
+public:
+    explicit Stage(TaskManager& pool) : pool(pool) {}
+    virtual ~Stage() = default;
+
+    TaskItem resumeTask(int priority = 0) {
+        Stage* stage = this;
+        return TaskItem::make([stage] { stage->resume(); }, priority);
+    }
+    void schedule(int priority = 0) { pool.submitTask(resumeTask(priority)); }
+    // Resumes the stage once fd is ready for events (POLLIN / POLLOUT).
+    void awaitReady(int fd, short events) {
+        Reactor::getInstance().watch(fd, events, pool, resumeTask());
+    }
+    TaskManager& getPool() const { return pool; }
+
+protected:
+    virtual void resume() = 0;
+
+private:
+    TaskManager& pool;
+};
+
+// Bounded channel from one stage to the next. Neither end blocks a thread:
+// when the channel is full (or empty), trySend (or tryReceive) keeps the
+// caller's resume task and returns false, and the other end submits that
+// task once it has made room (or sent a value, or closed the channel).
+// There is one sending and one receiving stage; values are meant to be
+// whole batches, so the mutex is taken once per batch.
+template <typename T>
+class Channel {
+public:
+    Channel(TaskManager& pool, size_t capacity)
+        : pool(pool), capacity(capacity ? capacity : 1), closed(false) {}
+
+    // Moves value in and returns true, or leaves it alone when full.
+    bool trySend(T& value, const TaskItem& resume) {
+        TaskItem wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (values.size() >= capacity) {
+                sender = resume;
+                return false;
+            }
+            values.push_back(std::move(value));
+            std::swap(wake, receiver);
+        }
+        if (!wake.empty()) pool.submitTask(wake);
+        return true;
+    }
+
+    // False when empty: the caller is then resumed by the next value, or,
+    // once the channel is closed and empty, sees drained and is not.
+    bool tryReceive(T& value, const TaskItem& resume, bool& drained) {
+        TaskItem wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            drained = closed && values.empty();
+            if (values.empty()) {
+                if (!closed) receiver = resume;
+                return false;
+            }
+            value = std::move(values.front());
+            values.pop_front();
+            std::swap(wake, sender);
+        }
+        if (!wake.empty()) pool.submitTask(wake);
+        return true;
+    }
+
+    // Called by the sender after its last value.
+    void close() {
+        TaskItem wake;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            std::swap(wake, receiver);
+        }
+        if (!wake.empty()) pool.submitTask(wake);
+    }
+
+private:
+    TaskManager& pool;
+    size_t capacity;
+    std::deque<T> values;
+    bool closed;
+    TaskItem sender;        // waiting for room
+    TaskItem receiver;      // waiting for a value
+    std::mutex mutex;
+};
+
 #endif // TASK_MANAGER_H 
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef UPDATE_BATCH_H
+#define UPDATE_BATCH_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <unordered_map>
+
+struct EdgeUpdate {
+    int u;
+    int v;
+    bool is_insert;
+};
+
+inline uint64_t edge_key(int u, int v) {
+    if (u > v) std::swap(u, v);
+    return (static_cast<uint64_t>(static_cast<uint32_t>(u)) << 32) | static_cast<uint32_t>(v);
+}
+
+struct EndpointGroup {
+    int shared;
+    size_t first;                   // index of updates[0] in the batch
+    std::vector<EdgeUpdate> updates;
+};
+
+// Visibility of the edges touched by a compacted batch while every update of
+// the batch is mined against one graph snapshot that already holds all of the
+// batch's insertions. Update i sees an edge inserted at j iff j <= i and an
+// edge deleted at j iff j >= i, which is exactly the graph stream order gives.
+class EdgeTimeline {
+public:
+    EdgeTimeline() = default;
+    explicit EdgeTimeline(const std::vector<EdgeUpdate>& net);
+
+    bool visible(int a, int b, size_t index) const {
+        if (edges.empty()) return true;
+        auto it = edges.find(edge_key(a, b));
+        if (it == edges.end()) return true;
+        return it->second.second ? it->second.first <= index : index <= it->second.first;
+    }
+
+private:
+    std::unordered_map<uint64_t, std::pair<size_t, bool>> edges;  // key -> (index, is_insert)
+};
+
+class UpdateBatch {
+public:
+    struct CompactionStats {
+        size_t input_updates;
+        size_t self_loops;
+        size_t redundant;       // insert of a present edge / delete of an absent one
+        size_t cancelled;       // state changes undone later in the same batch
+        size_t net_updates;
+    };
+
+    UpdateBatch() = default;
+    UpdateBatch(std::vector<EdgeUpdate>::const_iterator begin,
+                std::vector<EdgeUpdate>::const_iterator end)
+        : updates(begin, end) {}
+
+    void add(const EdgeUpdate& update) { updates.push_back(update); }
+    size_t size() const { return updates.size(); }
+    bool empty() const { return updates.empty(); }
+    const std::vector<EdgeUpdate>& get_updates() const { return updates; }
+
+    // Reduces the batch to its net effect on a graph where has_edge() holds
+    // at batch start. Each surviving update keeps the stream position of the
+    // last update on its edge, so applying them in order is equivalent to
+    // applying the original batch.
+    std::vector<EdgeUpdate> compact(const std::function<bool(int, int)>& has_edge,
+                                    CompactionStats* stats = nullptr) const;
+
+    // Splits an ordered update list into maximal consecutive runs whose
+    // updates all touch one shared endpoint. Stream order is preserved.
+    static std::vector<EndpointGroup> group_by_endpoint(const std::vector<EdgeUpdate>& updates);
+
+    // Line format: "u v" or "+ u v" inserts, "- u v" deletes.
+    static bool parse_line(const std::string& line, EdgeUpdate& update);
+
+private:
+    std::vector<EdgeUpdate> updates;
+};
+
+#endif // UPDATE_BATCH_H
@@ -0,0 +1,57 @@
+#ifndef UPDATE_ROUTER_H
+#define UPDATE_ROUTER_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+enum class UpdateLane {
+    FAST = 0,
+    HEAVY = 1
+};
+
+struct LaneStats {
+    size_t threads;
+    size_t updates;
+    size_t groups;
+    double total_latency_us;
+    double max_latency_us;
+    std::vector<size_t> histogram;  // bucket b counts latencies in [2^(b-1), 2^b) us
+
+    LaneStats() : threads(0), updates(0), groups(0), total_latency_us(0), max_latency_us(0),
+                  histogram(num_buckets, 0) {}
+
+    void record(double latency_us);
+    void merge(const LaneStats& other);
+    double mean_latency_us() const;
+    double percentile_us(double p) const;   // upper bound of the bucket holding p
+
+    static const int num_buckets = 40;
+};
+
+// Estimates the cost of mining an update from its endpoint degrees and routes
+// it to a lane. Per-bucket costs (bucket = log2 of the degree product) start
+// from a static guess and are refined from observed mining times.
+class UpdateRouter {
+public:
+    explicit UpdateRouter(double heavy_threshold_us = 500.0);
+
+    double estimate_us(size_t deg_u, size_t deg_v) const;
+    UpdateLane route(double estimated_us) const;
+    void observe(size_t deg_u, size_t deg_v, double elapsed_us);
+
+    void set_heavy_threshold(double us) { heavy_threshold_us = us; }
+    double get_heavy_threshold() const { return heavy_threshold_us; }
+
+private:
+    static int bucket_of(double work);
+    static double work_of(size_t deg_u, size_t deg_v);
+
+    double heavy_threshold_us;
+    std::vector<double> us_per_work;
+    std::vector<size_t> samples;
+
+    static const int num_buckets = 64;
+};
+
+#endif // UPDATE_ROUTER_H
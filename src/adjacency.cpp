@@ -0,0 +1,129 @@
+#include "../include/adjacency.h"
+#include <assert.h>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#ifndef INDEX
+#define INDEX(x,y,n) ((x)*(n)+(y))
+#endif
+
+
+void Adjacency::allocate(int _size)
+{
+    if (_size < 0 || _size > max_vertices)
+    {
+        printf("patterns are limited to %d vertices!\n", max_vertices);
+        assert(0);
+    }
+    size = _size;
+    rows = size <= inline_vertices ? buffer : new uint64_t[2 * size];
+    memset(rows, 0, 2 * size * sizeof(uint64_t));
+}
+
+Adjacency::Adjacency(int _size)
+{
+    allocate(_size);
+}
+
+Adjacency::Adjacency(const int* matrix, int _size)
+{
+    allocate(_size);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            if (matrix[INDEX(i, j, size)] != 0)
+                set(i, j, matrix[INDEX(i, j, size)] == 2 ? 2 : 1);
+}
+
+Adjacency::Adjacency(const Adjacency& other)
+{
+    allocate(other.size);
+    memcpy(rows, other.rows, 2 * size * sizeof(uint64_t));
+}
+
+Adjacency::Adjacency(Adjacency&& other) noexcept : size(other.size)
+{
+    if (other.rows == other.buffer)
+    {
+        rows = buffer;
+        memcpy(buffer, other.buffer, 2 * size * sizeof(uint64_t));
+    }
+    else
+    {
+        rows = other.rows;
+        other.rows = other.buffer;
+    }
+    other.size = 0;
+}
+
+Adjacency& Adjacency::operator=(const Adjacency& other)
+{
+    if (this != &other)
+    {
+        Adjacency copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+Adjacency& Adjacency::operator=(Adjacency&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    if (rows != buffer)
+        delete[] rows;
+    size = other.size;
+    if (other.rows == other.buffer)
+    {
+        rows = buffer;
+        memcpy(buffer, other.buffer, 2 * size * sizeof(uint64_t));
+    }
+    else
+    {
+        rows = other.rows;
+        other.rows = other.buffer;
+    }
+    other.size = 0;
+    return *this;
+}
+
+Adjacency::~Adjacency()
+{
+    if (rows != buffer)
+        delete[] rows;
+}
+
+void Adjacency::set(int x, int y, int value)
+{
+    const uint64_t bit = 1ULL << y;
+    rows[x] = value != 0 ? rows[x] | bit : rows[x] & ~bit;
+    rows[size + x] = value == 2 ? rows[size + x] | bit : rows[size + x] & ~bit;
+}
+
+void Adjacency::swap_vertices(int a, int b)
+{
+    if (a == b)
+        return;
+    std::swap(rows[a], rows[b]);
+    std::swap(rows[size + a], rows[size + b]);
+    for (int i = 0; i < 2 * size; ++i)
+    {
+        // exchange bits a and b of every row
+        uint64_t differ = ((rows[i] >> a) ^ (rows[i] >> b)) & 1;
+        rows[i] ^= (differ << a) | (differ << b);
+    }
+}
+
+std::vector<int> Adjacency::to_matrix() const
+{
+    std::vector<int> matrix(size * size);
+    for (int i = 0; i < size; ++i)
+        for (int j = 0; j < size; ++j)
+            matrix[INDEX(i, j, size)] = get(i, j);
+    return matrix;
+}
+
+bool Adjacency::operator==(const Adjacency& other) const
+{
+    return size == other.size && std::equal(rows, rows + 2 * size, other.rows);
+}
@@ -0,0 +1,138 @@
+#include "../include/auto_tuner.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <assert.h>
+
+
+double AutoTuner::time_sample(const MatchEngine& engine, const std::vector<std::pair<int, int>>& edges,
+                              const std::vector<MatchView>& views, size_t n, double cutoff_us,
+                              size_t& matches) const {
+    matches = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        matches += engine.count(edges[i], views[i]);
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed > cutoff_us) return -1.0;
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+TuningReport AutoTuner::tune(MatchEngine& engine, const std::vector<std::pair<int, int>>& edges,
+                             const std::vector<MatchView>& views) const {
+    TuningReport report = {1, 0, 0, 0};
+    const MatchPlan& plan = engine.get_plan();
+    MatchConfig best = plan.get_config();
+
+    // The warm-up run also sizes the sample: caches are cold for the first
+    // configuration, and a few heavy updates can exhaust the budget alone.
+    size_t n = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (n < edges.size() &&
+           std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() < sample_budget_us) {
+        engine.count(edges[n], views[n]);
+        n++;
+    }
+    report.sample_updates = n;
+
+    size_t expected;
+    const double unlimited = std::numeric_limits<double>::max();
+    report.initial_us = report.best_us = time_sample(engine, edges, views, n, unlimited, expected);
+
+    auto trial = [&](const MatchConfig& config) {
+        if (!engine.configure(config)) return;
+        size_t matches;
+        double us = time_sample(engine, edges, views, n, report.best_us, matches);
+        report.configurations++;
+        if (us < 0) return;
+        // every configuration enumerates the same subgraphs
+        assert(matches == expected);
+        if (us < report.best_us) {
+            report.best_us = us;
+            best = config;
+        }
+    };
+
+    for (size_t s = 0; s < plan.get_schedules().size(); ++s) {
+        const std::vector<std::vector<int>> alternatives = plan.get_alternatives(s);
+        for (const std::vector<int>& order : alternatives) {
+            if (order == best.orders[s]) continue;
+            MatchConfig config = best;
+            config.orders[s] = order;
+            trial(config);
+        }
+    }
+    const IntersectionKernel kernels[] = {IntersectionKernel::SMALLEST_SCAN, IntersectionKernel::SELECTIVE_PROBE,
+                                          IntersectionKernel::LAST_PARENT_SCAN, IntersectionKernel::LEAPFROG};
+    for (IntersectionKernel kernel : kernels) {
+        if (kernel == best.kernel) continue;
+        // leapfrog only runs where the views carry sorted neighborhoods
+        if (kernel == IntersectionKernel::LEAPFROG && (views.empty() || !views[0].sorted)) continue;
+        MatchConfig config = best;
+        config.kernel = kernel;
+        trial(config);
+    }
+
+    engine.configure(best);
+    return report;
+}
+
+bool AutoTuner::drifted(const GraphStatistics& stats) const {
+    if (!has_baseline) return true;
+    auto moved = [this](double before, double after) {
+        if (before <= 0) return after > 0;
+        return std::fabs(after - before) / before > drift_threshold;
+    };
+    return moved(baseline.neighbor_degree(), stats.neighbor_degree()) ||
+           moved(baseline.triangle_density, stats.triangle_density);
+}
+
+
+// File format, one item per line:
+//   kernel <k>
+//   order <v0> <v1> ... (one line per schedule, in DAG order)
+bool AutoTuner::save(const std::string& path, const MatchConfig& config) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Failed to write tuning file: " << path << std::endl;
+        return false;
+    }
+    file << "kernel " << static_cast<int>(config.kernel) << "\n";
+    for (const std::vector<int>& order : config.orders) {
+        file << "order";
+        for (int v : order) file << " " << v;
+        file << "\n";
+    }
+    return true;
+}
+
+bool AutoTuner::load(const std::string& path, MatchConfig& config) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+
+    MatchConfig loaded;
+    loaded.kernel = IntersectionKernel::SMALLEST_SCAN;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string key;
+        if (!(iss >> key)) continue;
+        if (key == "kernel") {
+            int k;
+            if (!(iss >> k) || k < 0 || k > static_cast<int>(IntersectionKernel::LEAPFROG)) return false;
+            loaded.kernel = static_cast<IntersectionKernel>(k);
+        } else if (key == "order") {
+            std::vector<int> order;
+            int v;
+            while (iss >> v) order.push_back(v);
+            loaded.orders.push_back(order);
+        } else {
+            return false;
+        }
+    }
+    config = loaded;
+    return true;
+}
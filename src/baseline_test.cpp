@@ -2,6 +2,7 @@
 #include "../include/mappings.h"
 #include "../include/dag.h"
 #include "../include/mining.h"
+#include "../include/plan_cache.h"
 // #include "../include/instance_restoration.h"
 // #include "../include/task_manager.h"
 // #include "../include/mongodb_utils.h"
@@ -11,144 +12,13 @@
 #include <cstring>
 #include <algorithm>
 #include <chrono>
+#include <unordered_map>
 
 #include "../include/schedule.h"
 
 
-bool is_isomorphic(const Mappings& m1, const Mappings& m2, int size) {
-    const int* adj1 = m1.get_adj_mat_ptr();
-    const int* adj2 = m2.get_adj_mat_ptr();
-
-    std::vector<int> perm(size);
-    for(int i = 0; i < size; ++i) perm[i] = i;
-
-    do {
-        bool is_same = true;
-
-        for(int i = 0; i < size && is_same; ++i) {
-            for(int j = 0; j < size && is_same; ++j) {
-                int val1 = adj1[INDEX(i, j, size)];
-                int val2 = adj2[INDEX(perm[i], perm[j], size)];
-
-                if (val1 != val2) {
-                    is_same = false;
-                }
-            }
-        }
-        if (is_same) return true;
-    } while(std::next_permutation(perm.begin(), perm.end()));
-
-    return false;
-}
-
-void generate_permutations(const int* adj_mat, int size) {
-
-    std::vector<int> vertices_to_permute;
-    for(int i = 2; i < size; ++i) {
-        vertices_to_permute.push_back(i);
-    }
-
-    std::sort(vertices_to_permute.begin(), vertices_to_permute.end());
-
-    // std::cout << "\nGenerated Schedules:\n";
-    int *opr_mat = new int[size * size];
-
-
-    do {
-
-        for(int i = 0; i < size; ++i)
-            for(int j = 0; j < size; ++j)
-                opr_mat[INDEX(i, j, size)] = adj_mat[INDEX(i, j, size)];
-
-        // std::cout << "Vertex Searched Order: ";
-        int stage = 2;
-        for(int v : vertices_to_permute) {
-            //[rule1] 
-            bool isconnected = false;
-            // std::cout << v << " ";
-            for (int j = 0; j < stage; j++) {
-                if(opr_mat[INDEX(j, v, size)] == 1)
-                    isconnected = true;
-            }
-
-            if (!isconnected) {
-                // std::cout<<"(invalid mining schedule) Rule 1";
-                break;
-            }
-
-            //[rule 2] 
-            if ((size-stage) == 1) {
-                // printf("\nGenerated Schedule:\n");
-                // for(int i = 0; i < size; ++i) {
-                //     for(int j = 0; j < size; ++j)
-                //         printf("%d", adj_mat[INDEX(i,j,size)]);
-                //     puts("");
-                // }
-                break;
-            }
-
-            int *edge_buffer = new int[size]();
-            bool is_valid = true;
-
-            int current_edges = 0;
-            for (int curr = 0; curr < stage; ++curr) {
-                if(opr_mat[INDEX(v, curr, size)] == 1)
-                    current_edges++;
-            }
-
-
-            for(int x = stage; x < size; ++x) {
-                if(x == v) continue;  
-
-                int edge_count = 0;
-                for (int curr = 0; curr < stage; ++curr) {
-                    if(opr_mat[INDEX(x, curr, size)] == 1)
-                        edge_count++;
-                }
-
-                // 
-                if (edge_count > current_edges) {
-                    // std::cout << "(invalid mining schedule) Rule 2 ";
-                    is_valid = false;
-                    break;
-                }
-            }
-
-            delete[] edge_buffer;
-            if (!is_valid) {
-                break;
-            }
-
-
-
-            if (v != stage) {
-
-                for (int j = 0; j < size; j++) {
-                    int temp = opr_mat[INDEX(stage, j, size)];
-                    opr_mat[INDEX(stage, j, size)] = opr_mat[INDEX(v, j, size)];
-                    opr_mat[INDEX(v, j, size)] = temp;
-                }
-
-                for (int i = 0; i < size; i++) {
-                    int temp = opr_mat[INDEX(i, stage, size)];
-                    opr_mat[INDEX(i, stage, size)] = opr_mat[INDEX(i, v, size)];
-                    opr_mat[INDEX(i, v, size)] = temp;
-                }
-            }
-
-
-            stage++;
-
-
-        }
-        // std::cout << "\n";
-    } while(std::next_permutation(vertices_to_permute.begin(), vertices_to_permute.end()));
-
-    delete[] opr_mat;
-}
-
-
-void test_pattern(const std::string &graphfile, const std::string &udpatefile, const Pattern &p) {
+// Schedules of every update-edge mapping of p that is unique up to symmetry.
+std::vector<Schedule> generate_schedules(const Pattern &p) {
     // p.print();
     // std::set< std::set<int> > pattern_edge;
     // p.count_all_isomorphism(pattern_edge);
@@ -163,29 +33,14 @@ void test_pattern(const std::string &graphfile, const std::string &udpatefile, c
 
     std::vector<Mappings> mappingses;
     const int size = p.get_size();
-    int* adj_mat = new int[size*size];
-    memset(adj_mat, 0, size * size * sizeof(int));
-    const int* pattern_adj_mat = p.get_adj_mat_ptr();
+    const Adjacency& pattern_adj = p.get_adjacency();
 
     for(int i = 0; i < size; ++i) {
         for(int j = i + 1; j < size; ++j) {
-            // if(pattern_adj_mat[i][j] == 1)
-            if (pattern_adj_mat[INDEX(i, j, size)] == 1) {
-                for(int x = 0; x < size; ++x)
-                    for(int y = 0; y < size; ++y)
-                        adj_mat[INDEX(x, y, size)] = pattern_adj_mat[INDEX(x, y, size)];
-
-                adj_mat[INDEX(i, j, size)] = 2;
-                adj_mat[INDEX(j, i, size)] = 2;
-
-                char* adj_str = new char[size * size + 1];
-                for(int x = 0; x < size * size; ++x) {
-                    adj_str[x] = adj_mat[x] + '0';
-                }
-                adj_str[size * size] = '\0';
-
-                Mappings initial_mapping(size, adj_str);
-                mappingses.push_back(initial_mapping);
+            if (pattern_adj.has_edge(i, j)) {
+                Adjacency adj(pattern_adj);
+                adj.add_update_mapping(i, j);
+                mappingses.push_back(Mappings(std::move(adj)));
             }
         }
     }
@@ -193,139 +48,112 @@ void test_pattern(const std::string &graphfile, const std::string &udpatefile, c
 
     for(size_t i = 0; i < mappingses.size(); ++i) {
         // std::cout << "\nMapping #" << i + 1 << ":\n";
-        const int* curr_adj_mat = mappingses[i].get_adj_mat_ptr()   ;
+        // const Adjacency& curr_adj = mappingses[i].get_adjacency();
 
         // for(int x = 0; x < size; ++x) {
         //     for(int y = 0; y < size; ++y) {
-        //         std::cout << curr_adj_mat[INDEX(x, y, size)] << " ";
+        //         std::cout << curr_adj.get(x, y) << " ";
         //     }
         //     std::cout << "\n";
         // }
         // std::cout << "------------------------\n";
     }
 
-    delete[] adj_mat;
-
     std::vector<bool> is_unique(mappingses.size(), true);  
-    std::vector<std::pair<int, int>> update_edges;  
 
+    // mappings are equivalent iff their canonical forms match; the hash
+    // only narrows the candidates down
+    std::vector<CanonicalLabeling> forms;
+    std::unordered_map<uint64_t, std::vector<size_t>> form_index;
     for(size_t i = 0; i < mappingses.size(); ++i) {
-        if (!is_unique[i]) continue;
-
-        const int* curr_adj = mappingses[i].get_adj_mat_ptr();
-        std::pair<int, int> edge;
-        for(int x = 0; x < size; ++x) {
-            for(int y = x + 1; y < size; ++y) {
-                if(curr_adj[INDEX(x, y, size)] == 2) {
-                    edge = {x, y};
-                    break;
-                }
-            }
-        }
-        update_edges.push_back(edge);
-
-        for(size_t j = i + 1; j < mappingses.size(); ++j) {
-            if (!is_unique[j]) continue;
-
-            if (is_isomorphic(mappingses[i], mappingses[j], size)) {
-                is_unique[j] = false;
+        forms.push_back(mappingses[i].canonical_form());
+        for (size_t j : form_index[forms[i].get_hash()]) {
+            if (forms[i] == forms[j]) {
+                is_unique[i] = false;
+                break;
             }
         }
+        if (!is_unique[i]) continue;
+        form_index[forms[i].get_hash()].push_back(i);
     }
 
-    int unique_count = std::count(is_unique.begin(), is_unique.end(), true);
-    // std::cout << "\nAfter breaking edge symmetrys, there remains " << unique_count << " mappings\n";
+    std::vector<Schedule> schedules;
 
-    // std::cout << "\nFinal Results:\n";
-    int idx = 0;
     for(size_t i = 0; i < mappingses.size(); ++i) {
         if (!is_unique[i]) continue;
+        Schedule sche(mappingses[i].get_adjacency());
+        Schedule nsche = sche.generate_schedules();
+        // nsche.print_schedule();
+        schedules.push_back(std::move(nsche));
 
-        int a = update_edges[idx].first;
-        int b = update_edges[idx].second;
-
-        std::vector<int> colors1(size, 0);  
-        colors1[a] = 1;  
-        colors1[b] = 2; 
-
-        std::vector<int> colors2(size, 0);  
-        colors2[a] = 2;  
-        colors2[b] = 1;  
-
-        bool is_color_symmetric = false;
-        std::vector<int> perm(size);
-        for(int i = 0; i < size; ++i) perm[i] = i;
-
-        do {
-            bool matches = true;
-            for(int i = 0; i < size; ++i) {
-                if(colors1[i] != colors2[perm[i]]) {
-                    matches = false;
-                    break;
-                }
-            }
-
-            if(matches) {
-                const int* adj = mappingses[i].get_adj_mat_ptr();
-                for(int x = 0; x < size && matches; ++x) {
-                    for(int y = 0; y < size && matches; ++y) {
-                        if(adj[INDEX(x, y, size)] != adj[INDEX(perm[x], perm[y], size)]) {
-                            matches = false;
-                        }
-                    }
-                }
-            }
-            if(matches) {
-                is_color_symmetric = true;
-                break;
-            }
-        } while(std::next_permutation(perm.begin(), perm.end()));
-
-        // std::cout << "\nMapping #" << i + 1 << ":\n";
-        // if (is_color_symmetric) {
-        //     std::cout << "Vertex pair: (" << a << "," << b << ")\n";
-        // } else {
-        //     std::cout << "Vertex pair: (" << a << "," << b << "), (" << b << "," << a << ")\n";
-        // }
-
-        // const int* curr_adj_mat = mappingses[i].get_adj_mat_ptr();
-        // for(int x = 0; x < size; ++x) {
-        //     for(int y = 0; y < size; ++y) {
-        //         std::cout << curr_adj_mat[INDEX(x, y, size)] << " ";
-        //     }
-        //     std::cout << "\n";
-        // }
-
-        idx++;
     }
 
+    return schedules;
+}
 
-    std::vector<Schedule> schedules;
-
-    for(size_t i = 0; i < mappingses.size(); ++i) {
-        if (!is_unique[i]) continue;
-        Schedule sche(mappingses[i].get_adj_mat_ptr(), size);
-        int *reorder = new int[size * size];
-        sche.generate_schedules(reorder);
-
-        generate_permutations(reorder, size);
 
-        Schedule nsche(reorder, size);
-        // nsche.print_schedule();
-        schedules.push_back(nsche);
+// Several patterns of one size are mined together: their schedules share one
+// DAG and the match count is the sum over the patterns.
+void test_pattern(const std::string &graphfile, const std::string &udpatefile, const std::vector<Pattern> &patterns,
+                  bool auto_tune, const std::string &plan_cache_dir, bool decompose, bool leapfrog,
+                  size_t frontier_budget, size_t threads, const std::string &output_file) {
+    const Pattern &p = patterns.front();
+    const int size = p.get_size();
 
-    }
+    // the plan cache is keyed by a single pattern
+    const bool use_cache = !plan_cache_dir.empty() && patterns.size() == 1;
+    PlanCache plan_cache(plan_cache_dir);
+    CompiledPlan compiled;
+    bool cached = use_cache && plan_cache.load(p, compiled);
 
     //
     std::vector<DAG> all_dags;  
+    if (cached) {
+        std::vector<Schedule> schedules;
+        for (const std::vector<int>& matrix : compiled.matrices)
+            schedules.push_back(Schedule(matrix.data(), compiled.size));
+        all_dags.push_back(DAG(schedules));
+        std::cout << "Loaded compiled plan from " << plan_cache.path_for(p) << std::endl;
+    } else {
+        for (const Pattern &pattern : patterns)
+            all_dags.push_back(DAG(generate_schedules(pattern)));
+    }
     auto combined_dag = DAG::DAG_combination(all_dags); 
 
     Mining mining(graphfile, 
-                     udpatefile, combined_dag);
+                     udpatefile, combined_dag, cached ? &compiled : nullptr);
+
+    if (auto_tune) {
+        mining.set_auto_tune();
+    }
+    if (decompose) {
+        mining.set_decomposition(true);
+    }
+    if (leapfrog) {
+        mining.set_leapfrog(true);
+    }
+    mining.set_frontier_budget(frontier_budget);
+    mining.set_threads(threads);
+    mining.set_output_file(output_file);
+    if (auto_tune && !use_cache) {
+        // the tuned configuration is kept next to the patterns it was tuned for
+        std::string tuning_file = "pattern_" + std::to_string(size);
+        for (const Pattern &pattern : patterns) {
+            tuning_file += "_";
+            for (int x = 0; x < size * size; ++x)
+                tuning_file += static_cast<char>('0' + pattern.get_adjacency().get(x / size, x % size));
+        }
+        mining.set_tuning_file(tuning_file + ".tune");
+    }
     
     if (mining.initialize()) {
+        if (use_cache && !cached && mining.get_compiled_plan(compiled))
+            plan_cache.store(p, compiled);
         std::cout << "\nStarting mining process...\n";
         mining.run();
+        // keep the tuning choices and any orders compiled while tuning
+        if (use_cache && mining.get_last_tuning().configurations > 0 && mining.get_compiled_plan(compiled))
+            plan_cache.store(p, compiled);
     }
 
 }
@@ -335,7 +163,7 @@ void test_pattern(const std::string &graphfile, const std::string &udpatefile, c
 int main(int argc,char *argv[]) {
 
     if(argc < 5) {
-        printf("Usage: %s dataset_name graph_file pattern_size pattern_adjacency_matrix\n", argv[0]);
+        printf("Usage: %s dataset_name graph_file pattern_size pattern_adjacency_matrix[,matrix...] [--tune] [--plan-cache dir] [--decompose] [--leapfrog] [--frontier MB] [--threads N] [--output file]\n", argv[0]);
         printf("Example(Triangle counting on dataset WikiVote) : \n");
         printf("%s dataset/example.txt dataset/updates.txt 5 0111010011100011100001100\n", argv[0]);
         return 0;
@@ -346,12 +174,47 @@ int main(int argc,char *argv[]) {
     const std::string path = argv[2];
 
     int size = atoi(argv[3]);
-    char* adj_mat = argv[4];
 
-    Pattern p(size, adj_mat);
+    // comma-separated matrices: patterns of the same size mined together
+    std::vector<Pattern> patterns;
+    std::string matrices = argv[4];
+    for (size_t begin = 0; begin <= matrices.size(); ) {
+        size_t end = matrices.find(',', begin);
+        if (end == std::string::npos) end = matrices.size();
+        std::string adj_mat = matrices.substr(begin, end - begin);
+        if (static_cast<int>(adj_mat.size()) != size * size) {
+            printf("adjacency matrix %s does not have %d entries\n", adj_mat.c_str(), size * size);
+            return 1;
+        }
+        patterns.push_back(Pattern(size, &adj_mat[0]));
+        begin = end + 1;
+    }
 
     auto start = std::chrono::high_resolution_clock::now();
-    test_pattern(type, path, p);
+    bool auto_tune = false;
+    std::string plan_cache_dir;
+    bool decompose = false;
+    bool leapfrog = false;
+    size_t frontier_budget = 0;
+    size_t threads = 0;
+    std::string output_file;
+    for (int i = 5; i < argc; ++i) {
+        if (std::string(argv[i]) == "--tune")
+            auto_tune = true;
+        else if (std::string(argv[i]) == "--plan-cache" && i + 1 < argc)
+            plan_cache_dir = argv[++i];
+        else if (std::string(argv[i]) == "--decompose")
+            decompose = true;
+        else if (std::string(argv[i]) == "--leapfrog")
+            leapfrog = true;
+        else if (std::string(argv[i]) == "--frontier" && i + 1 < argc)
+            frontier_budget = static_cast<size_t>(atof(argv[++i]) * (1 << 20));
+        else if (std::string(argv[i]) == "--threads" && i + 1 < argc)
+            threads = static_cast<size_t>(atoi(argv[++i]));
+        else if (std::string(argv[i]) == "--output" && i + 1 < argc)
+            output_file = argv[++i];
+    }
+    test_pattern(type, path, patterns, auto_tune, plan_cache_dir, decompose, leapfrog, frontier_budget, threads, output_file);
     auto end = std::chrono::high_resolution_clock::now();
 
     // auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
@@ -0,0 +1,249 @@
+#include "../include/canonical.h"
+#include <algorithm>
+#include <set>
+
+
+namespace {
+
+std::vector<int> orbits_of(const std::vector< std::vector<int> >& gens, int size)
+{
+    std::vector<int> parent(size);
+    for (int i = 0; i < size; ++i)
+        parent[i] = i;
+    auto find = [&parent](int x) {
+        while (parent[x] != x)
+            x = parent[x] = parent[parent[x]];
+        return x;
+    };
+    for (const std::vector<int>& g : gens)
+        for (int v = 0; v < size; ++v)
+        {
+            int a = find(v), b = find(g[v]);
+            if (a != b)
+                parent[std::max(a, b)] = std::min(a, b);
+        }
+    for (int v = 0; v < size; ++v)
+        parent[v] = find(v);
+    return parent;
+}
+
+}
+
+
+CanonicalLabeling::CanonicalLabeling(const int* adj_mat, int _size, const std::vector<int>& _colors)
+    : adj(adj_mat), size(_size), input_colors(_colors), hash(0)
+{
+    if (input_colors.empty())
+        input_colors.assign(size, 0);
+
+    // initial partition: vertices ordered by their input color
+    std::vector<int> sorted(input_colors);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+    std::vector<int> cell(size);
+    for (int v = 0; v < size; ++v)
+        cell[v] = std::lower_bound(sorted.begin(), sorted.end(), input_colors[v]) - sorted.begin();
+
+    std::vector<int> path;
+    if (size > 0)
+        search(cell, path);
+    orbit = orbits_of(generators, size);
+
+    hash = 1469598103934665603ULL;
+    auto mix = [this](int value) {
+        hash ^= static_cast<uint64_t>(static_cast<uint32_t>(value));
+        hash *= 1099511628211ULL;
+    };
+    mix(size);
+    for (int c : colors)
+        mix(c);
+    for (int x : matrix)
+        mix(x);
+
+    adj = nullptr;
+}
+
+// Splits cells until every vertex of a cell sees the same number of vertices
+// of each cell over each edge color. Cells keep their relative order, so the
+// result only depends on the graph up to isomorphism.
+void CanonicalLabeling::refine(std::vector<int>& cell) const
+{
+    typedef std::pair<int, std::vector< std::pair<int, std::pair<int, int> > > > Key;
+
+    int cells = 1 + *std::max_element(cell.begin(), cell.end());
+    while (cells < size)
+    {
+        std::vector<Key> keys(size);
+        for (int v = 0; v < size; ++v)
+        {
+            keys[v].first = cell[v];
+            keys[v].second.emplace_back(-1, std::make_pair(adj[INDEX(v, v, size)], 0));
+            for (int u = 0; u < size; ++u)
+                if (u != v && (adj[INDEX(v, u, size)] != 0 || adj[INDEX(u, v, size)] != 0))
+                    keys[v].second.emplace_back(cell[u], std::make_pair(adj[INDEX(v, u, size)], adj[INDEX(u, v, size)]));
+            std::sort(keys[v].second.begin(), keys[v].second.end());
+        }
+
+        std::vector<Key> sorted(keys);
+        std::sort(sorted.begin(), sorted.end());
+        sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+        if (static_cast<int>(sorted.size()) == cells)
+            break;
+        for (int v = 0; v < size; ++v)
+            cell[v] = std::lower_bound(sorted.begin(), sorted.end(), keys[v]) - sorted.begin();
+        cells = sorted.size();
+    }
+}
+
+void CanonicalLabeling::search(std::vector<int>& cell, std::vector<int>& path)
+{
+    refine(cell);
+
+    // target: the first cell holding more than one vertex
+    std::vector<int> count(size, 0);
+    for (int v = 0; v < size; ++v)
+        count[cell[v]]++;
+    int target = -1;
+    for (int c = 0; c < size && target < 0; ++c)
+        if (count[c] > 1)
+            target = c;
+    if (target < 0)
+    {
+        leaf(cell);
+        return;
+    }
+
+    std::vector<int> explored;
+    for (int w = 0; w < size; ++w)
+    {
+        if (cell[w] != target)
+            continue;
+
+        // skip w if a known automorphism fixing the path maps it onto an
+        // explored vertex: its subtree is an image of one already searched
+        std::vector< std::vector<int> > fixing;
+        for (const std::vector<int>& g : generators)
+        {
+            bool fixes = true;
+            for (int p : path)
+                if (g[p] != p)
+                {
+                    fixes = false;
+                    break;
+                }
+            if (fixes)
+                fixing.push_back(g);
+        }
+        std::vector<int> orb = orbits_of(fixing, size);
+        bool pruned = false;
+        for (int x : explored)
+            if (orb[x] == orb[w])
+            {
+                pruned = true;
+                break;
+            }
+        if (pruned)
+            continue;
+        explored.push_back(w);
+
+        // individualize w: it goes in front of the rest of its cell
+        std::vector<int> child(size);
+        for (int v = 0; v < size; ++v)
+            child[v] = 2 * cell[v] + (cell[v] == target && v != w ? 1 : 0);
+        std::vector<int> ranks(child);
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        for (int v = 0; v < size; ++v)
+            child[v] = std::lower_bound(ranks.begin(), ranks.end(), child[v]) - ranks.begin();
+
+        path.push_back(w);
+        search(child, path);
+        path.pop_back();
+    }
+}
+
+void CanonicalLabeling::leaf(const std::vector<int>& cell)
+{
+    std::vector<int> leaf_colors(size);
+    std::vector<int> leaf_matrix(size * size);
+    for (int i = 0; i < size; ++i)
+    {
+        leaf_colors[cell[i]] = input_colors[i];
+        for (int j = 0; j < size; ++j)
+            leaf_matrix[INDEX(cell[i], cell[j], size)] = adj[INDEX(i, j, size)];
+    }
+
+    if (first_labeling.empty())
+    {
+        first_labeling = labeling = cell;
+        first_matrix = matrix = leaf_matrix;
+        colors = leaf_colors;
+        return;
+    }
+
+    // equal forms differ by an automorphism: v -> the vertex that the other
+    // leaf placed where this one places v
+    const std::vector<int>* other = nullptr;
+    if (leaf_matrix == first_matrix)
+        other = &first_labeling;
+    else if (leaf_matrix == matrix)
+        other = &labeling;
+    if (other)
+    {
+        std::vector<int> inverse(size);
+        for (int v = 0; v < size; ++v)
+            inverse[(*other)[v]] = v;
+        std::vector<int> perm(size);
+        for (int v = 0; v < size; ++v)
+            perm[v] = inverse[cell[v]];
+        add_generator(perm);
+        return;
+    }
+
+    if (leaf_matrix > matrix)
+    {
+        labeling = cell;
+        matrix = leaf_matrix;
+        colors = leaf_colors;
+    }
+}
+
+void CanonicalLabeling::add_generator(const std::vector<int>& perm)
+{
+    for (int v = 0; v < size; ++v)
+        if (perm[v] != v)
+        {
+            generators.push_back(perm);
+            return;
+        }
+}
+
+std::vector< std::vector<int> > CanonicalLabeling::get_automorphisms() const
+{
+    std::vector<int> identity(size);
+    for (int v = 0; v < size; ++v)
+        identity[v] = v;
+
+    std::set< std::vector<int> > group;
+    std::vector< std::vector<int> > frontier(1, identity);
+    group.insert(identity);
+    while (!frontier.empty())
+    {
+        std::vector<int> g = frontier.back();
+        frontier.pop_back();
+        for (const std::vector<int>& s : generators)
+        {
+            std::vector<int> h(size);
+            for (int v = 0; v < size; ++v)
+                h[v] = s[g[v]];
+            if (group.insert(h).second)
+                frontier.push_back(h);
+        }
+    }
+    return std::vector< std::vector<int> >(group.begin(), group.end());
+}
+
+bool CanonicalLabeling::operator==(const CanonicalLabeling& other) const
+{
+    return size == other.size && hash == other.hash && colors == other.colors && matrix == other.matrix;
+}
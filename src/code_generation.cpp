@@ -358,13 +358,8 @@ std::string CodeGeneration::generateSetOperationCode(SetOperation op,
 
 std::set<int> CodeGeneration::getNeighbors(const DAG& dag, int vertex) {
     std::set<int> neighbors;
-    int size = dag.get_size();
-    const int* adj_matrix = dag.get_adj_matrix();
-
-    for (int i = 0; i < size; ++i) {
-        if (adj_matrix[vertex * size + i] > 0) {
-            neighbors.insert(i);
-        }
+    for (uint64_t m = dag.get_adjacency().row(vertex); m != 0; m &= m - 1) {
+        neighbors.insert(__builtin_ctzll(m));
     }
 
     return neighbors;
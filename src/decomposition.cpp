@@ -0,0 +1,331 @@
+#include "../include/decomposition.h"
+#include "../include/match_engine.h"
+#include "../include/canonical.h"
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace {
+
+// Separator mapping of a tuple followed by a sorted subset of its own
+// vertices: the keys of the join's per-partition hash tables.
+struct JoinKey {
+    int size;
+    int v[PatternDecomposition::max_separator + PatternDecomposition::max_own];
+
+    bool operator==(const JoinKey& other) const {
+        return size == other.size && std::equal(v, v + size, other.v);
+    }
+};
+
+inline uint64_t hash_ints(const int* v, int size) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    for (int i = 0; i < size; ++i) {
+        h ^= static_cast<uint32_t>(v[i]);
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+struct JoinKeyHash {
+    size_t operator()(const JoinKey& key) const { return hash_ints(key.v, key.size); }
+};
+
+// Tuples per partition the join aims for, so a partition's hash table stays
+// in cache; the partition count is capped at 2^max_partition_bits.
+const size_t partition_tuples = 2048;
+const int max_partition_bits = 8;
+
+}
+
+
+std::vector<PatternDecomposition> PatternDecomposition::candidates(const int* adj, int size) {
+    std::vector<PatternDecomposition> result;
+    int x = -1, y = -1;
+    for (int i = 0; i < size && x < 0; ++i)
+        for (int j = i + 1; j < size; ++j)
+            if (adj[INDEX(i, j, size)] == 2) { x = i; y = j; break; }
+    if (x < 0) return result;
+
+    std::vector<int> rest;
+    for (int v = 0; v < size; ++v)
+        if (v != x && v != y) rest.push_back(v);
+    const size_t automorphisms = CanonicalLabeling(adj, size).get_automorphisms().size();
+
+    // every separator of up to max_separator vertices that contains the update edge
+    for (int extra = 0; extra <= max_separator - 2 && extra <= static_cast<int>(rest.size()) - 2; ++extra) {
+        std::vector<bool> pick(rest.size(), false);
+        std::fill(pick.begin(), pick.begin() + extra, true);
+        do {
+            std::vector<int> separator = {x, y};
+            std::vector<bool> removed(size, false);
+            removed[x] = removed[y] = true;
+            for (size_t i = 0; i < rest.size(); ++i) {
+                if (pick[i]) {
+                    separator.push_back(rest[i]);
+                    removed[rest[i]] = true;
+                }
+            }
+
+            // components of the pattern without the separator
+            std::vector<std::vector<int>> components;
+            std::vector<bool> seen(removed);
+            for (int v : rest) {
+                if (seen[v]) continue;
+                std::vector<int> component(1, v);
+                seen[v] = true;
+                for (size_t i = 0; i < component.size(); ++i)
+                    for (int u = 0; u < size; ++u)
+                        if (!seen[u] && adj[INDEX(component[i], u, size)] != 0) {
+                            seen[u] = true;
+                            component.push_back(u);
+                        }
+                components.push_back(component);
+            }
+            if (components.size() < 2) continue;
+
+            // every split of the components in two groups; the first
+            // component stays on side 0 so no split is tried twice
+            const size_t c = components.size();
+            for (uint64_t mask = 0; mask + 1 < (1ULL << (c - 1)); ++mask) {
+                std::vector<int> own[2];
+                for (size_t i = 0; i < c; ++i) {
+                    int group = i > 0 && ((mask >> (i - 1)) & 1) == 0 ? 1 : 0;
+                    own[group].insert(own[group].end(), components[i].begin(), components[i].end());
+                }
+                if (static_cast<int>(own[0].size()) > max_own || static_cast<int>(own[1].size()) > max_own)
+                    continue;
+                PatternDecomposition d;
+                d.separator = separator;
+                d.automorphisms = automorphisms;
+                if (build_side(adj, size, separator, own[0], d.sides[0]) &&
+                    build_side(adj, size, separator, own[1], d.sides[1]))
+                    result.push_back(d);
+            }
+        } while (std::prev_permutation(pick.begin(), pick.end()));
+    }
+    return result;
+}
+
+// Orders the side like Schedule::generate_orders() does: the update edge,
+// then always a vertex with the most links to the ones placed. Fails when
+// the side is not connected through its own edges.
+bool PatternDecomposition::build_side(const int* adj, int size, const std::vector<int>& separator,
+                                      const std::vector<int>& own, JoinSide& side) {
+    std::vector<int> members(separator.begin() + 2, separator.end());
+    members.insert(members.end(), own.begin(), own.end());
+
+    side.vertices = {separator[0], separator[1]};
+    while (!members.empty()) {
+        size_t best = 0;
+        int best_links = 0;
+        for (size_t i = 0; i < members.size(); ++i) {
+            int links = 0;
+            for (int v : side.vertices)
+                if (adj[INDEX(v, members[i], size)] != 0) links++;
+            if (links > best_links) {
+                best = i;
+                best_links = links;
+            }
+        }
+        if (best_links == 0) return false;
+        side.vertices.push_back(members[best]);
+        members.erase(members.begin() + best);
+    }
+
+    const int m = side.vertices.size();
+    side.size = m;
+    side.matrix.assign(m * m, 0);
+    side.parents.assign(m, std::vector<int>());
+    for (int i = 0; i < m; ++i)
+        for (int j = 0; j < m; ++j)
+            side.matrix[INDEX(i, j, m)] = adj[INDEX(side.vertices[i], side.vertices[j], size)];
+    for (int l = 2; l < m; ++l)
+        for (int j = 0; j < l; ++j)
+            if (side.matrix[INDEX(j, l, m)] != 0) side.parents[l].push_back(j);
+
+    side.key_levels.clear();
+    side.own_levels.clear();
+    for (int v : separator)
+        side.key_levels.push_back(std::find(side.vertices.begin(), side.vertices.end(), v) - side.vertices.begin());
+    for (int l = 2; l < m; ++l)
+        if (std::find(separator.begin(), separator.end(), side.vertices[l]) == separator.end())
+            side.own_levels.push_back(l);
+    return true;
+}
+
+double PatternDecomposition::estimate(const ScheduleCostModel& model) const {
+    double cost = 0.0;
+    for (const JoinSide& side : sides) {
+        std::vector<int> order(side.size);
+        for (int l = 0; l < side.size; ++l) order[l] = l;
+        std::vector<double> candidates;
+        double work = model.estimate(side.matrix.data(), side.size, order, candidates);
+        double tuples = 1.0;
+        for (int l = 2; l < side.size; ++l) tuples *= candidates[l];
+        cost += work + tuples * (1 << side.own_levels.size());
+    }
+    return cost;
+}
+
+size_t PatternDecomposition::count(const std::pair<int, int>& edge, const MatchView& view) const {
+    JoinRelation relations[2];
+    for (int i = 0; i < 2; ++i) {
+        relations[i].key_size = separator.size();
+        relations[i].own_size = sides[i].own_levels.size();
+        for (int orientation = 0; orientation < 2; ++orientation) {
+            int a = orientation ? edge.second : edge.first;
+            int b = orientation ? edge.first : edge.second;
+            enumerate(sides[i], a, b, view, relations[i]);
+        }
+        if (relations[i].size() == 0) return 0;
+    }
+
+    // build on the side with fewer subset entries
+    size_t entries[2];
+    for (int i = 0; i < 2; ++i) entries[i] = relations[i].size() << relations[i].own_size;
+    int build = entries[0] <= entries[1] ? 0 : 1;
+    long long embeddings = join(relations[build], relations[1 - build]);
+    return static_cast<size_t>(embeddings) / automorphisms;
+}
+
+void PatternDecomposition::enumerate(const JoinSide& side, int a, int b, const MatchView& view,
+                                     JoinRelation& out) const {
+    const int m = side.size;
+    std::vector<int> mapping(m, -1);
+    std::vector<std::vector<int>> candidates(m);
+    std::vector<size_t> position(m, 0);
+    std::vector<int> own;
+    mapping[0] = a;
+    mapping[1] = b;
+
+    auto emit = [&]() {
+        for (int l : side.key_levels) out.keys.push_back(mapping[l]);
+        own.clear();
+        for (int l : side.own_levels) own.push_back(mapping[l]);
+        std::sort(own.begin(), own.end());
+        out.owns.insert(out.owns.end(), own.begin(), own.end());
+    };
+    auto fill = [&](int level) {
+        const std::vector<int>& parents = side.parents[level];
+        std::vector<int>& result = candidates[level];
+        result.clear();
+        position[level] = 0;
+        const std::unordered_set<int>* source = nullptr;
+        int scanned = -1;
+        for (int j : parents) {
+            const auto& adj = view.adjacency(mapping[j]);
+            if (!source || adj.size() < source->size()) {
+                source = &adj;
+                scanned = j;
+            }
+        }
+        for (int v : *source) {
+            bool ok = true;
+            for (int j : parents) {
+                if (!view.visible(mapping[j], v) ||
+                    (j != scanned && view.adjacency(mapping[j]).count(v) == 0)) {
+                    ok = false;
+                    break;
+                }
+            }
+            for (int l = 0; l < level && ok; ++l)
+                if (mapping[l] == v) ok = false;
+            if (ok) result.push_back(v);
+        }
+    };
+
+    if (m == 2) {
+        emit();
+        return;
+    }
+    fill(2);
+    int level = 2;
+    while (level >= 2) {
+        if (position[level] == candidates[level].size()) {
+            level--;
+            continue;
+        }
+        mapping[level] = candidates[level][position[level]++];
+        if (level == m - 1) {
+            emit();
+            continue;
+        }
+        fill(++level);
+    }
+}
+
+// Radix-partitioned hash join: both relations are scattered by the top bits
+// of the key hash, then each partition builds a table of key + own-subset
+// counts from the build side and probes it with every tuple of the other.
+// For a probe tuple with own vertices P the pairs sharing no vertex are
+//   sum over subsets T of P of (-1)^|T| * #{build tuples of the key containing T}.
+long long PatternDecomposition::join(const JoinRelation& build, const JoinRelation& probe) {
+    const int k = build.key_size;
+    const JoinRelation* relations[2] = {&build, &probe};
+
+    int bits = 0;
+    while (bits < max_partition_bits && ((build.size() + probe.size()) >> bits) > partition_tuples) ++bits;
+    const size_t partitions = size_t(1) << bits;
+    auto partition_of = [&](const int* key) -> size_t {
+        return bits ? hash_ints(key, k) >> (64 - bits) : 0;
+    };
+
+    // offsets[r][p] .. offsets[r][p + 1] index the tuples of partition p in order[r]
+    std::vector<size_t> offsets[2], order[2];
+    for (int r = 0; r < 2; ++r) {
+        const JoinRelation& rel = *relations[r];
+        offsets[r].assign(partitions + 1, 0);
+        std::vector<size_t> part(rel.size());
+        for (size_t t = 0; t < rel.size(); ++t) {
+            part[t] = partition_of(&rel.keys[t * k]);
+            offsets[r][part[t] + 1]++;
+        }
+        for (size_t p = 0; p < partitions; ++p) offsets[r][p + 1] += offsets[r][p];
+        std::vector<size_t> fill(offsets[r].begin(), offsets[r].end() - 1);
+        order[r].resize(rel.size());
+        for (size_t t = 0; t < rel.size(); ++t) order[r][fill[part[t]]++] = t;
+    }
+
+    long long total = 0;
+    std::unordered_map<JoinKey, long long, JoinKeyHash> table;
+    JoinKey key;
+    for (size_t p = 0; p < partitions; ++p) {
+        if (offsets[1][p] == offsets[1][p + 1] || offsets[0][p] == offsets[0][p + 1]) continue;
+        table.clear();
+        const int own = build.own_size;
+        for (size_t i = offsets[0][p]; i < offsets[0][p + 1]; ++i) {
+            size_t t = order[0][i];
+            std::copy(&build.keys[t * k], &build.keys[t * k] + k, key.v);
+            const int* vertices = &build.owns[t * own];
+            for (uint32_t subset = 0; subset < (1u << own); ++subset) {
+                key.size = k;
+                for (int j = 0; j < own; ++j)
+                    if ((subset >> j) & 1) key.v[key.size++] = vertices[j];
+                table[key]++;
+            }
+        }
+
+        const int probe_own = probe.own_size;
+        for (size_t i = offsets[1][p]; i < offsets[1][p + 1]; ++i) {
+            size_t t = order[1][i];
+            std::copy(&probe.keys[t * k], &probe.keys[t * k] + k, key.v);
+            const int* vertices = &probe.owns[t * probe_own];
+            for (uint32_t subset = 0; subset < (1u << probe_own); ++subset) {
+                int bits_set = __builtin_popcount(subset);
+                if (bits_set > own) continue;
+                key.size = k;
+                for (int j = 0; j < probe_own; ++j)
+                    if ((subset >> j) & 1) key.v[key.size++] = vertices[j];
+                auto it = table.find(key);
+                if (it == table.end()) {
+                    if (subset == 0) break;     // no build tuple has this key
+                    continue;
+                }
+                total += bits_set % 2 ? -it->second : it->second;
+            }
+        }
+    }
+    return total;
+}
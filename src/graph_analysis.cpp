@@ -10,14 +10,12 @@ GraphAnalysis::GraphAnalysis(const DAG& dag) : dag_(dag) {
 
 void GraphAnalysis::buildAdjacencyList() {
     int size = dag_.get_size();
-    const int* adj_matrix = dag_.get_adj_matrix();
+    const Adjacency& adj = dag_.get_adjacency();
     adjacency_list_.resize(size);
     
     for (int i = 0; i < size; ++i) {
-        for (int j = 0; j < size; ++j) {
-            if (adj_matrix[i * size + j] > 0) {
-                adjacency_list_[i].push_back(j);
-            }
+        for (uint64_t m = adj.row(i); m != 0; m &= m - 1) {
+            adjacency_list_[i].push_back(__builtin_ctzll(m));
         }
     }
 }
@@ -28,15 +26,11 @@ int GraphAnalysis::getVertexCount() const {
 
 int GraphAnalysis::getEdgeCount() const {
     int count = 0;
-    const int* adj_matrix = dag_.get_adj_matrix();
+    const Adjacency& adj = dag_.get_adjacency();
     int size = dag_.get_size();
     
     for (int i = 0; i < size; ++i) {
-        for (int j = 0; j < size; ++j) {
-            if (adj_matrix[i * size + j] > 0) {
-                ++count;
-            }
-        }
+        count += adj.degree(i);
     }
     return count;
 }
@@ -50,14 +44,12 @@ double GraphAnalysis::getDensity() const {
 std::vector<int> GraphAnalysis::getDegrees() const {
     int size = dag_.get_size();
     std::vector<int> degrees(size, 0);
-    const int* adj_matrix = dag_.get_adj_matrix();
+    const Adjacency& adj = dag_.get_adjacency();
     
     for (int i = 0; i < size; ++i) {
-        for (int j = 0; j < size; ++j) {
-            if (adj_matrix[i * size + j] > 0) {
-                ++degrees[i];  
-                ++degrees[j];  
-            }
+        degrees[i] += adj.degree(i);
+        for (uint64_t m = adj.row(i); m != 0; m &= m - 1) {
+            ++degrees[__builtin_ctzll(m)];
         }
     }
     return degrees;
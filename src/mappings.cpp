@@ -8,11 +8,9 @@
 #include <algorithm>
 
 
-Mappings::Mappings(int _size, char *buffer)
+Mappings::Mappings(int _size, char *buffer) : adj(_size)
 {
     size = _size;
-    adj_mat = new int[size * size];
-    memset(adj_mat, 0, size * size * sizeof(int));
 
     for(int i = 0; i < size; ++i)
         for(int j = 0; j < size; ++j)
@@ -25,33 +23,25 @@ Mappings::Mappings(int _size, char *buffer)
 }
 
 
-Mappings::~Mappings()
-{
-    // delete[] adj_mat;
-}
-
 void Mappings::add_edge(int x, int y)
 {
-    adj_mat[INDEX(x, y, size)] = 1;
-    adj_mat[INDEX(y, x, size)] = 1;
+    adj.add_edge(x, y);
 }
 
 void Mappings::del_edge(int x, int y)
 {
-    adj_mat[INDEX(x, y, size)] = 0;
-    adj_mat[INDEX(y, x, size)] = 0;
+    adj.del_edge(x, y);
 }
 
 void Mappings::add_update_mapping(int x, int y) {
-    adj_mat[INDEX(x, y, size)] = 2;
-    adj_mat[INDEX(y, x, size)] = 2;
+    adj.add_update_mapping(x, y);
 }
 
 void Mappings::print() const
 {
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            if (adj_mat[INDEX(i, j, size)] != 0)
+            if (adj.has_edge(i, j))
                 printf("(%d,%d) ", i, j);
     printf("\n");
 }
\ No newline at end of file
@@ -0,0 +1,645 @@
+#include "../include/match_engine.h"
+#include "../include/canonical.h"
+#include <assert.h>
+#include <algorithm>
+#include <cstdio>
+#include <climits>
+
+
+const std::unordered_set<int>& MatchView::adjacency(int vertex) const {
+    static const std::unordered_set<int> empty;
+    auto it = graph->find(vertex);
+    return it != graph->end() ? it->second : empty;
+}
+
+
+void MatchProfile::merge(const MatchProfile& other) {
+    if (expansions.size() < other.expansions.size()) {
+        expansions.resize(other.expansions.size(), 0);
+        candidates.resize(other.candidates.size(), 0);
+    }
+    for (size_t i = 0; i < other.expansions.size(); ++i) {
+        expansions[i] += other.expansions[i];
+        candidates[i] += other.candidates[i];
+    }
+    intersections += other.intersections;
+}
+
+double MatchProfile::mean_candidates(size_t schedule, int level, int size) const {
+    size_t i = schedule * size + level;
+    if (i >= expansions.size() || expansions[i] == 0) return 0.0;
+    return static_cast<double>(candidates[i]) / expansions[i];
+}
+
+
+MatchPlan::MatchPlan(const DAG& dag, const ScheduleCostModel* cost_model, size_t num_alternatives,
+                     const CompiledPlan* compiled)
+    : size(dag.get_size()), kernel(IntersectionKernel::SMALLEST_SCAN) {
+    if (cost_model) model.reset(new ScheduleCostModel(*cost_model));
+
+    for (const Schedule& sched : dag.get_schedules()) {
+        matrices.push_back(sched.get_adjacency().to_matrix());
+    }
+    // a compiled plan only applies to exactly these schedules
+    if (compiled && compiled->size == size && compiled->matrices == matrices &&
+        compiled->orders.size() == matrices.size() && compiled->restrictions.size() == matrices.size()) {
+        orders = compiled->orders;
+        restrictions = compiled->restrictions;
+    } else {
+        for (const Schedule& sched : dag.get_schedules()) {
+            orders.push_back(sched.generate_orders());
+        }
+        restrictions.assign(matrices.size(), std::map<std::vector<int>, Restrictions>());
+    }
+
+    for (size_t s = 0; s < matrices.size(); ++s) {
+        const int n = size;
+        const int* adj = matrices[s].data();
+        std::vector<std::vector<int>> ranked = orders[s];
+        if (ranked.empty()) {
+            printf("pattern is not connected!\n");
+            assert(0);
+        }
+        orders_considered.push_back(ranked.size());
+        if (model) {
+            std::vector<double> costs(ranked.size()), candidates;
+            std::vector<size_t> rank(ranked.size());
+            for (size_t i = 0; i < ranked.size(); ++i) {
+                costs[i] = model->estimate(adj, n, ranked[i], candidates);
+                rank[i] = i;
+            }
+            std::stable_sort(rank.begin(), rank.end(), [&costs](size_t a, size_t b) { return costs[a] < costs[b]; });
+            std::vector<std::vector<int>> cheapest;
+            for (size_t i = 0; i < rank.size() && i < std::max<size_t>(1, num_alternatives); ++i) {
+                cheapest.push_back(ranked[rank[i]]);
+            }
+            ranked.swap(cheapest);
+        } else if (ranked.size() > std::max<size_t>(1, num_alternatives)) {
+            ranked.resize(std::max<size_t>(1, num_alternatives));
+        }
+        alternatives.push_back(ranked);
+    }
+
+    for (size_t s = 0; s < matrices.size(); ++s) {
+        schedules.push_back(compile(s, alternatives[s].front()));
+    }
+    build_trie();
+}
+
+MatchConfig MatchPlan::get_config() const {
+    MatchConfig config;
+    for (const MatchSchedule& ms : schedules) {
+        config.orders.push_back(ms.order);
+    }
+    config.kernel = kernel;
+    return config;
+}
+
+bool MatchPlan::configure(const MatchConfig& config) {
+    if (config.orders.size() != matrices.size()) return false;
+    for (size_t s = 0; s < matrices.size(); ++s) {
+        if (!is_valid_order(s, config.orders[s])) return false;
+    }
+    for (size_t s = 0; s < matrices.size(); ++s) {
+        if (config.orders[s] != schedules[s].order) {
+            schedules[s] = compile(s, config.orders[s]);
+        }
+    }
+    kernel = config.kernel;
+    build_trie();
+    return true;
+}
+
+void MatchPlan::build_trie() {
+    trie = ScheduleTrie();
+    steps.clear();
+    for (size_t s = 0; s < schedules.size(); ++s) {
+        if (std::find(joined.begin(), joined.end(), s) != joined.end()) continue;
+        const MatchSchedule& ms = schedules[s];
+        std::vector<TrieStep> keys;
+        for (int l = 1; l < size; ++l) {
+            TrieStep key = {0, 0, 0};
+            for (int j : ms.parents[l]) key.parents |= 1ULL << j;
+            for (int j : ms.greater_than[l]) key.greater_than |= 1ULL << j;
+            for (int j : ms.less_than[l]) key.less_than |= 1ULL << j;
+            keys.push_back(key);
+        }
+        std::vector<int> path = trie.insert(keys);
+        steps.resize(trie.get_nodes().size());
+        for (int l = 1; l < size; ++l) {
+            MatchStep& step = steps[path[l]];
+            if (step.schedules.empty()) {
+                step.parents = ms.parents[l];
+                step.less_than = ms.less_than[l];
+                step.greater_than = ms.greater_than[l];
+            }
+            step.schedules.push_back(s);
+        }
+    }
+    steps.resize(trie.get_nodes().size());
+}
+
+size_t MatchPlan::set_decomposition(bool enabled) {
+    joined.clear();
+    decompositions.clear();
+    join_costs.clear();
+    if (enabled && model) {
+        for (size_t s = 0; s < schedules.size(); ++s) {
+            std::vector<PatternDecomposition> splits = PatternDecomposition::candidates(matrices[s].data(), size);
+            double best_cost = schedules[s].estimated_cost;
+            int best = -1;
+            for (size_t i = 0; i < splits.size(); ++i) {
+                // the join enumerates its sides without symmetry breaking,
+                // the order's restrictions cut its matches by up to that much
+                double cost = splits[i].estimate(*model) * splits[i].get_automorphisms();
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best = i;
+                }
+            }
+            if (best < 0) continue;
+            joined.push_back(s);
+            decompositions.push_back(splits[best]);
+            join_costs.push_back(best_cost);
+        }
+    }
+    build_trie();
+    return joined.size();
+}
+
+bool MatchPlan::is_valid_order(size_t schedule, const std::vector<int>& order) const {
+    const int n = size;
+    const int* adj = matrices[schedule].data();
+    if (static_cast<int>(order.size()) != n) return false;
+
+    std::vector<bool> placed(n, false);
+    for (int v : order) {
+        if (v < 0 || v >= n || placed[v]) return false;
+        placed[v] = true;
+    }
+    if (n < 2 || adj[INDEX(order[0], order[1], n)] != 2) return false;
+
+    // rule 1 and rule 2 of Schedule::generate_orders()
+    std::vector<int> links(n, 0);
+    std::fill(placed.begin(), placed.end(), false);
+    for (int l = 0; l < n; ++l) {
+        int v = order[l];
+        if (l >= 2) {
+            int best = 0;
+            for (int u = 0; u < n; ++u)
+                if (!placed[u]) best = std::max(best, links[u]);
+            if (links[v] == 0 || links[v] != best) return false;
+        }
+        placed[v] = true;
+        for (int u = 0; u < n; ++u)
+            if (adj[INDEX(v, u, n)] != 0) links[u]++;
+    }
+    return true;
+}
+
+CompiledPlan MatchPlan::get_compiled() const {
+    CompiledPlan compiled;
+    compiled.size = size;
+    compiled.matrices = matrices;
+    compiled.orders = orders;
+    compiled.restrictions = restrictions;
+    compiled.tuned = false;
+    compiled.config = get_config();
+    return compiled;
+}
+
+MatchSchedule MatchPlan::compile(size_t schedule, const std::vector<int>& order) {
+    const int n = size;
+    const int* adj = matrices[schedule].data();
+
+    MatchSchedule ms;
+    ms.order = order;
+    ms.estimated_cost = model ? model->estimate(adj, n, order, ms.estimated_candidates) : 0.0;
+    ms.orders_considered = orders_considered[schedule];
+    ms.parents.resize(n);
+    ms.less_than.resize(n);
+    ms.greater_than.resize(n);
+    for (int l = 1; l < n; ++l)
+        for (int j = 0; j < l; ++j)
+            if (adj[INDEX(order[j], order[l], n)] != 0)
+                ms.parents[l].push_back(j);
+
+    auto known = restrictions[schedule].find(order);
+    if (known == restrictions[schedule].end()) {
+        known = restrictions[schedule].insert(std::make_pair(order, symmetry_restrictions(schedule, order))).first;
+    }
+    // each restriction is checked at whichever of its two levels comes later
+    for (const std::pair<int, int>& r : known->second) {
+        if (r.second > r.first) ms.greater_than[r.second].push_back(r.first);
+        else ms.less_than[r.first].push_back(r.second);
+    }
+
+    return ms;
+}
+
+// Symmetry breaking over the automorphisms that map the update edge onto
+// itself (the only edge marked 2): fix vertices in matching order and require
+// each to take the smallest data vertex of its orbit under the stabilizer of
+// the vertices fixed so far, so every subgraph is found once.
+Restrictions MatchPlan::symmetry_restrictions(size_t schedule, const std::vector<int>& order) const {
+    const int n = size;
+    const int* adj = matrices[schedule].data();
+
+    std::vector<int> level(n);
+    for (int l = 0; l < n; ++l) level[order[l]] = l;
+
+    Restrictions result;
+    std::vector<int> fixed(n, 0);
+    for (int l = 0; l < n; ++l) {
+        CanonicalLabeling stabilizer(adj, n, fixed);
+        if (stabilizer.get_generators().empty()) break;
+        int v = order[l];
+        for (int w = 0; w < n; ++w) {
+            if (w == v || !stabilizer.same_orbit(v, w)) continue;
+            result.push_back(std::make_pair(l, level[w]));   // m[v] < m[w]
+        }
+        fixed[v] = l + 1;
+    }
+    return result;
+}
+
+void MatchPlan::print(const MatchProfile* profile) const {
+    printf("Match plan over %d pattern vertices, %zu schedules\n", size, schedules.size());
+    printf("Schedule trie: %zu nodes for %zu matching steps\n", trie.get_nodes().size() - 1, trie.get_steps());
+    for (size_t i = 0; i < schedules.size(); ++i) {
+        const MatchSchedule& ms = schedules[i];
+        printf("Order:");
+        for (int v : ms.order) printf(" %d", v);
+        printf("  Restrictions:");
+        for (size_t l = 0; l < ms.order.size(); ++l) {
+            for (int j : ms.greater_than[l]) printf(" m%d<m%zu", j, l);
+            for (int j : ms.less_than[l]) printf(" m%zu<m%d", l, j);
+        }
+        printf("\n");
+        size_t join = std::find(joined.begin(), joined.end(), i) - joined.begin();
+        if (join < joined.size()) {
+            const PatternDecomposition& d = decompositions[join];
+            printf("  Joined at separator");
+            for (int v : d.get_separator()) printf(" %d", v);
+            printf(", sides of %zu and %zu vertices: estimated cost %.4g instead of %.4g\n",
+                   d.get_side(0).own_levels.size(), d.get_side(1).own_levels.size(),
+                   join_costs[join], ms.estimated_cost);
+            continue;
+        }
+        if (ms.estimated_candidates.empty()) continue;
+        printf("  Estimated cost %.4g (best of %zu orders)\n", ms.estimated_cost, ms.orders_considered);
+        for (int l = 2; l < size; ++l) {
+            printf("  Level %d: estimated %.4g candidates", l, ms.estimated_candidates[l]);
+            if (profile) printf(", observed %.4g", profile->mean_candidates(i, l, size));
+            printf("\n");
+        }
+    }
+}
+
+
+MatchCursor MatchEngine::start(const std::pair<int, int>& edge) const {
+    const int n = plan.get_size();
+    MatchCursor cursor;
+    cursor.edge = edge;
+    cursor.orientation = 0;
+    cursor.depth = -1;
+    cursor.mapping.assign(n, -1);
+    cursor.node.assign(n, 0);
+    cursor.child.assign(n, 0);
+    cursor.candidates.assign(n, std::vector<int>());
+    cursor.position.assign(n, 0);
+    cursor.joins = 0;
+    cursor.branch = -1;
+    cursor.count = 0;
+    cursor.done = plan.get_schedules().empty();
+    cursor.profile.expansions.assign(plan.get_schedules().size() * n, 0);
+    cursor.profile.candidates.assign(plan.get_schedules().size() * n, 0);
+    return cursor;
+}
+
+size_t MatchEngine::count(const std::pair<int, int>& edge, const MatchView& view, MatchProfile* profile) const {
+    MatchCursor cursor = start(edge);
+    resume(cursor, view);
+    if (profile) profile->merge(cursor.profile);
+    return cursor.count;
+}
+
+size_t MatchEngine::count_branch(const std::pair<int, int>& edge, const MatchView& view, size_t branch,
+                                 MatchProfile* profile) const {
+    const size_t roots = plan.get_trie().get_nodes()[0].children.size();
+    if (branch >= 2 * roots) return plan.get_decompositions()[branch - 2 * roots].count(edge, view);
+
+    MatchCursor cursor = start(edge);
+    cursor.orientation = static_cast<int>(branch / roots);
+    cursor.mapping[0] = cursor.orientation ? edge.second : edge.first;
+    cursor.branch = static_cast<int>(branch % roots);
+    cursor.child[0] = cursor.branch;
+    cursor.depth = 0;
+    resume(cursor, view);
+    if (profile) profile->merge(cursor.profile);
+    return cursor.count;
+}
+
+size_t MatchEngine::count_frontier(const std::pair<int, int>& edge, const MatchView& view, size_t budget_bytes,
+                                   MatchProfile* profile) const {
+    const int n = plan.get_size();
+    const std::vector<ScheduleTrie::Node>& nodes = plan.get_trie().get_nodes();
+    MatchCursor cursor = start(edge);
+    const size_t limit = std::max<size_t>(1, budget_bytes / (n * sizeof(int)));
+
+    for (int orientation = 0; orientation < 2 && !cursor.done; ++orientation) {
+        const int a = orientation ? edge.second : edge.first;
+        const int b = orientation ? edge.first : edge.second;
+        for (int next : nodes[0].children) {
+            const MatchStep& step = plan.get_steps()[next];
+            // level 1 can only be restricted against level 0
+            if ((!step.greater_than.empty() && a >= b) || (!step.less_than.empty() && a <= b)) continue;
+            if (n == 2) {
+                cursor.count += nodes[next].ends;
+                continue;
+            }
+            extend_frontier(cursor, next, std::vector<int>{a, b}, limit, view);
+        }
+    }
+    for (const PatternDecomposition& join : plan.get_decompositions()) {
+        cursor.count += join.count(edge, view);
+    }
+    if (profile) profile->merge(cursor.profile);
+    return cursor.count;
+}
+
+// frontier holds the partial matches of the levels up to node's, one after
+// the other. Each child is matched for all of them before the next child,
+// and a grandchild frontier is handed down whenever it reaches the limit.
+void MatchEngine::extend_frontier(MatchCursor& cursor, int node, const std::vector<int>& frontier, size_t limit,
+                                  const MatchView& view) const {
+    const std::vector<ScheduleTrie::Node>& nodes = plan.get_trie().get_nodes();
+    const int level = nodes[node].level + 1;
+    const int width = level;
+    const size_t matches = frontier.size() / width;
+    const bool last = level == plan.get_size() - 1;
+
+    std::vector<size_t> order(matches);
+    std::vector<int> extended;
+    for (int child : nodes[node].children) {
+        // neighbors of equal vertices are read back to back
+        const int key = plan.get_steps()[child].parents.front();
+        for (size_t i = 0; i < matches; ++i) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&frontier, key, width](size_t x, size_t y) {
+            return frontier[x * width + key] < frontier[y * width + key];
+        });
+
+        extended.clear();
+        for (size_t i = 0; i < matches; ++i) {
+            if (i + prefetch_distance < matches) {
+                int ahead = frontier[order[i + prefetch_distance] * width + key];
+                if (view.sorted) {
+                    __builtin_prefetch(view.sorted->neighbors(ahead).data());
+                } else {
+                    const std::unordered_set<int>& adj = view.adjacency(ahead);
+                    if (!adj.empty()) __builtin_prefetch(&*adj.begin());
+                }
+            }
+            const int* match = &frontier[order[i] * width];
+            std::copy(match, match + width, cursor.mapping.begin());
+            fill_candidates(cursor, child, level, view);
+            const std::vector<int>& candidates = cursor.candidates[level];
+            if (last) {
+                cursor.count += candidates.size() * nodes[child].ends;
+                continue;
+            }
+            for (int v : candidates) {
+                extended.insert(extended.end(), match, match + width);
+                extended.push_back(v);
+            }
+            if (extended.size() / (width + 1) >= limit) {
+                extend_frontier(cursor, child, extended, limit, view);
+                extended.clear();
+            }
+        }
+        if (!extended.empty()) extend_frontier(cursor, child, extended, limit, view);
+    }
+}
+
+void MatchEngine::fill_candidates(MatchCursor& cursor, int node, int level, const MatchView& view) const {
+    const MatchStep& step = plan.get_steps()[node];
+    const std::vector<int>& parents = step.parents;
+    const std::vector<int>& mapping = cursor.mapping;
+    std::vector<int>& out = cursor.candidates[level];
+    out.clear();
+    const IntersectionKernel kernel = plan.get_kernel();
+    if (kernel == IntersectionKernel::LEAPFROG && view.sorted) {
+        leapfrog_candidates(cursor, step, level, view);
+        return;
+    }
+
+    // Iterate the smallest parent neighborhood, or the cached common
+    // neighborhood when the shared endpoint of the update group is a parent.
+    const std::unordered_set<int>* source = nullptr;
+    int covered[2] = {-1, -1};
+    if (view.cache && parents.size() >= 2) {
+        for (size_t i = 0; i < parents.size() && !source; ++i) {
+            if (mapping[parents[i]] != view.cache->vertex) continue;
+            int other = parents[i == 0 ? 1 : 0];
+            source = view.cache->find(mapping[other]);
+            if (!source) {
+                const auto& Na = view.adjacency(view.cache->vertex);
+                const auto& Nb = view.adjacency(mapping[other]);
+                const auto& small = Na.size() <= Nb.size() ? Na : Nb;
+                const auto& large = Na.size() <= Nb.size() ? Nb : Na;
+                std::unordered_set<int>& common = view.cache->common[mapping[other]];
+                for (int v : small)
+                    if (large.find(v) != large.end()) common.insert(v);
+                source = &common;
+            }
+            covered[0] = parents[i];
+            covered[1] = other;
+        }
+    }
+    if (!source) {
+        if (kernel == IntersectionKernel::LAST_PARENT_SCAN) {
+            source = &view.adjacency(mapping[parents.back()]);
+            covered[0] = parents.back();
+        } else {
+            for (int j : parents) {
+                const auto& adj = view.adjacency(mapping[j]);
+                if (!source || adj.size() < source->size()) {
+                    source = &adj;
+                    covered[0] = j;
+                }
+            }
+        }
+    }
+
+    std::vector<const std::unordered_set<int>*>& probes = cursor.probes;
+    probes.clear();
+    for (int j : parents) {
+        if (j != covered[0] && j != covered[1]) probes.push_back(&view.adjacency(mapping[j]));
+    }
+    const bool selective = kernel == IntersectionKernel::SELECTIVE_PROBE;
+    if (selective) {
+        // the smallest neighborhoods reject the most candidates
+        std::sort(probes.begin(), probes.end(),
+                  [](const std::unordered_set<int>* a, const std::unordered_set<int>* b) { return a->size() < b->size(); });
+    }
+
+    for (int v : *source) {
+        bool ok = true;
+        if (!selective) {
+            for (int j : parents)
+                if (!view.visible(mapping[j], v)) { ok = false; break; }
+            if (!ok) continue;
+        }
+        for (const std::unordered_set<int>* adj : probes)
+            if (adj->find(v) == adj->end()) { ok = false; break; }
+        if (!ok) continue;
+        if (selective) {
+            for (int j : parents)
+                if (!view.visible(mapping[j], v)) { ok = false; break; }
+            if (!ok) continue;
+        }
+        for (int l = 0; l < level; ++l)
+            if (mapping[l] == v) { ok = false; break; }
+        if (!ok) continue;
+        for (int j : step.greater_than)
+            if (mapping[j] >= v) { ok = false; break; }
+        if (!ok) continue;
+        for (int j : step.less_than)
+            if (mapping[j] <= v) { ok = false; break; }
+        if (ok) out.push_back(v);
+    }
+
+    // every schedule through the node would have built this set on its own
+    cursor.profile.intersections++;
+    for (size_t s : step.schedules) {
+        size_t slot = s * plan.get_size() + level;
+        cursor.profile.expansions[slot]++;
+        cursor.profile.candidates[slot] += out.size();
+    }
+}
+
+// Generic join step: the candidates are the intersection of every parent's
+// sorted neighborhood, found in one leapfrog pass that starts above the
+// greater_than levels and stops at the less_than ones, so it never produces
+// more than the smallest neighborhood holds.
+void MatchEngine::leapfrog_candidates(MatchCursor& cursor, const MatchStep& step, int level,
+                                      const MatchView& view) const {
+    const std::vector<int>& mapping = cursor.mapping;
+    std::vector<int>& out = cursor.candidates[level];
+
+    int lower = INT_MIN, upper = INT_MAX;
+    for (int j : step.greater_than) lower = std::max(lower, mapping[j] + 1);
+    for (int j : step.less_than) upper = std::min(upper, mapping[j]);
+    cursor.lists.clear();
+    for (int j : step.parents) cursor.lists.push_back(&view.sorted->neighbors(mapping[j]));
+    SortedAdjacency::intersect(cursor.lists, out, lower, upper);
+
+    size_t kept = 0;
+    for (int v : out) {
+        bool ok = true;
+        for (int j : step.parents)
+            if (!view.visible(mapping[j], v)) { ok = false; break; }
+        for (int l = 0; l < level && ok; ++l)
+            if (mapping[l] == v) ok = false;
+        if (ok) out[kept++] = v;
+    }
+    out.resize(kept);
+
+    cursor.profile.intersections++;
+    for (size_t s : step.schedules) {
+        size_t slot = s * plan.get_size() + level;
+        cursor.profile.expansions[slot]++;
+        cursor.profile.candidates[slot] += out.size();
+    }
+}
+
+// Depth-first walk of the schedule trie. At depth d the levels up to d are
+// mapped and child[d] picks the next child of node[d] to extend them with;
+// once the children are exhausted the next candidate of level d is taken.
+bool MatchEngine::resume(MatchCursor& cursor, const MatchView& view,
+                         std::chrono::steady_clock::time_point deadline) const {
+    const int n = plan.get_size();
+    const std::vector<ScheduleTrie::Node>& nodes = plan.get_trie().get_nodes();
+    const bool timed = deadline != std::chrono::steady_clock::time_point::max();
+    size_t steps = 0;
+
+    while (!cursor.done) {
+        if (timed && ++steps % deadline_check_interval == 0 &&
+            std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+
+        if (cursor.depth < 0) {
+            if (cursor.orientation == 2) {
+                // joined schedules are counted one whole join at a time
+                const std::vector<PatternDecomposition>& joins = plan.get_decompositions();
+                if (cursor.joins < joins.size()) {
+                    cursor.count += joins[cursor.joins++].count(cursor.edge, view);
+                    continue;
+                }
+                cursor.done = true;
+                break;
+            }
+            cursor.mapping[0] = cursor.orientation ? cursor.edge.second : cursor.edge.first;
+            cursor.node[0] = 0;
+            cursor.child[0] = 0;
+            cursor.depth = 0;
+            continue;
+        }
+
+        int d = cursor.depth;
+        if (d == 0 && cursor.branch >= 0 && cursor.child[0] != static_cast<size_t>(cursor.branch)) {
+            cursor.done = true;     // the one root child of count_branch() is done
+            break;
+        }
+        const ScheduleTrie::Node& current = nodes[cursor.node[d]];
+        if (cursor.child[d] == current.children.size()) {
+            if (d == 0) {
+                cursor.orientation++;
+                cursor.depth = -1;
+            } else if (d >= 2 && cursor.position[d] < cursor.candidates[d].size()) {
+                cursor.mapping[d] = cursor.candidates[d][cursor.position[d]++];
+                cursor.child[d] = 0;
+            } else {
+                cursor.depth = d - 1;
+            }
+            continue;
+        }
+
+        int next = current.children[cursor.child[d]++];
+        int level = d + 1;
+        const MatchStep& step = plan.get_steps()[next];
+        if (level == 1) {
+            // the other endpoint of the update edge is the only candidate
+            int v = cursor.orientation ? cursor.edge.first : cursor.edge.second;
+            bool ok = true;
+            for (int j : step.greater_than)
+                if (cursor.mapping[j] >= v) ok = false;
+            for (int j : step.less_than)
+                if (cursor.mapping[j] <= v) ok = false;
+            if (!ok) continue;
+            if (n == 2) {
+                cursor.count += nodes[next].ends;
+                continue;
+            }
+            cursor.mapping[1] = v;
+            cursor.node[1] = next;
+            cursor.child[1] = 0;
+            cursor.depth = 1;
+            continue;
+        }
+
+        fill_candidates(cursor, next, level, view);
+        if (level == n - 1) {
+            cursor.count += cursor.candidates[level].size() * nodes[next].ends;
+            continue;
+        }
+        if (cursor.candidates[level].empty()) continue;
+        cursor.node[level] = next;
+        cursor.position[level] = 0;
+        cursor.mapping[level] = cursor.candidates[level][cursor.position[level]++];
+        cursor.child[level] = 0;
+        cursor.depth = level;
+    }
+    return true;
+}
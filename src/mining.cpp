@@ -1,9 +1,115 @@
 #include "../include/mining.h"
+#include "../include/task_manager.h"
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <condition_variable>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+
+namespace {
+
+// Customer of a mining pool. Tasks keep what they observe in the batch's
+// slot for the worker that ran them, and the batch reduces the slots once
+// all tasks are done.
+class MiningWorker : public Customer {
+public:
+    MiningWorker(const std::string& id, size_t index) : Customer(id), index(index) {}
+
+    const size_t index;     // within its pool
+
+protected:
+    void processTask(const Task& task) override {
+        std::cerr << "Mining workers only run typed tasks, not " << task.getTaskType() << std::endl;
+    }
+};
+
+// Mining pools are named by their worker count, "mining-<threads>", and have
+// exactly that many customers; instances asking for the same count share one.
+std::mutex mining_pools_mutex;
+std::set<size_t> mining_pools;     // counts whose pool has its customers
+
+// One line of run()'s output, in the format of the update file plus the count.
+void format_result(const UpdateResult& result, std::string& out) {
+    out += result.is_insert ? "+ " : "- ";
+    out += std::to_string(result.u);
+    out += ' ';
+    out += std::to_string(result.v);
+    out += ' ';
+    out += std::to_string(result.matches);
+    out += '\n';
+}
+
+void add_stats(UpdateBatch::CompactionStats& total, const UpdateBatch::CompactionStats& stats) {
+    total.input_updates += stats.input_updates;
+    total.self_loops += stats.self_loops;
+    total.redundant += stats.redundant;
+    total.cancelled += stats.cancelled;
+    total.net_updates += stats.net_updates;
+}
+
+}
+
+
+// One batch as it is mined: its net updates, their timeline and endpoint
+// groups, and in task runtime mode the state shared by the batch's tasks.
+struct Mining::BatchContext {
+    std::vector<EdgeUpdate> net;
+    EdgeTimeline timeline;
+    std::vector<EndpointGroup> groups;
+    std::vector<int> lane;                                  // of each group
+    std::vector<std::unique_ptr<SharedEndpointCache>> caches;   // of each group of several updates
+    std::vector<MatchProfile> profiles;                     // of each worker
+    std::vector<LaneStats> stats;                           // of each worker and lane
+    std::unique_ptr<std::atomic<size_t>[]> remaining;       // branches of each group still running
+    std::unique_ptr<std::atomic<size_t>[]> matches;         // of each update, over its branches
+    std::unique_ptr<std::atomic<uint64_t>[]> elapsed_ns;    // of each update, over its branches
+    std::chrono::steady_clock::time_point start;
+    std::atomic<size_t> pending;                            // tasks not finished, plus the submitter
+    TaskItem resume;                                        // submitted when all are; if empty,
+    bool finished;                                          // this is set instead, under mutex
+    std::mutex mutex;
+    std::condition_variable done;
+
+    // Called once by every task and once by the submitter; the last call
+    // may be the last touch of the context before its owner frees it.
+    void release(TaskManager& pool) {
+        if (pending.fetch_sub(1) != 1) return;
+        if (!resume.empty()) {
+            TaskItem next = resume;
+            pool.submitTask(next);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        done.notify_all();
+    }
+};
+
+
+Mining::Mining(const std::string& graph_path, const std::string& update_path, std::unique_ptr<DAG>& input_dag,
+               const CompiledPlan* compiled)
+    : graph_file_path(graph_path), update_file_path(update_path), dag(std::move(input_dag)),
+      pattern_count(0), removed_count(0), batch_size(default_batch_size), lane_threads{1, default_heavy_threads()},
+      latency_budget_us(0), completion_threads(1), deferred_count(0),
+      static_count(0), static_threads(default_static_threads()),
+      tune_check_interval(0), updates_since_check(0), tuned(false), last_tuning{0, 0, 0, 0},
+      decompose(false), leapfrog(false), frontier_budget(0), runtime_threads(0), runtime(nullptr) {
+    if (dag && !dag->get_schedules().empty()) {
+        engine.reset(new MatchEngine(*dag, nullptr, 1, compiled));
+        if (compiled && compiled->tuned) compiled_config.reset(new MatchConfig(compiled->config));
+    }
+}
 
 
 std::unordered_set<int> Mining::neighborhood(int vertex) const {
@@ -14,9 +120,43 @@ std::unordered_set<int> Mining::neighborhood(int vertex) const {
 }
 
 
-void Mining::process(const std::vector<int>& embeddings) {
+const std::unordered_set<int>& Mining::adjacency(int vertex) const {
+    static const std::unordered_set<int> empty;
+    auto it = graph.find(vertex);
+    return it != graph.end() ? it->second : empty;
+}
+
+
+const std::unordered_set<int>& Mining::common_neighbors(int a, int b, std::unordered_set<int>& scratch,
+                                                        SharedEndpointCache* cache) const {
+    std::unordered_set<int>* target = &scratch;
+    if (cache && (a == cache->vertex || b == cache->vertex)) {
+        int other = (a == cache->vertex) ? b : a;
+        const std::unordered_set<int>* cached = cache->find(other);
+        if (cached) {
+            return *cached;
+        }
+        target = &cache->common[other];
+    }
 
-    ++pattern_count;
+    const auto& Na = adjacency(a);
+    const auto& Nb = adjacency(b);
+    const auto& small = Na.size() <= Nb.size() ? Na : Nb;
+    const auto& large = Na.size() <= Nb.size() ? Nb : Na;
+
+    target->clear();
+    for (int v : small) {
+        if (large.find(v) != large.end()) {
+            target->insert(v);
+        }
+    }
+    return *target;
+}
+
+
+void Mining::process(const std::vector<int>& embeddings, size_t& count) const {
+
+    ++count;
 }
 
 
@@ -32,6 +172,17 @@ void Mining::add_edge(int u, int v) {
     add_node(v);
     graph[u].insert(v);
     graph[v].insert(u);
+    if (sorted_graph) sorted_graph->add_edge(u, v);
+}
+
+
+void Mining::remove_edge(int u, int v) {
+    auto it_u = graph.find(u);
+    auto it_v = graph.find(v);
+    if (it_u == graph.end() || it_v == graph.end()) return;
+    it_u->second.erase(v);
+    it_v->second.erase(u);
+    if (sorted_graph) sorted_graph->remove_edge(u, v);
 }
 
 
@@ -59,7 +210,453 @@ void Mining::mining(const std::pair<int, int>& edge, bool add_to_graph) {
     if (add_to_graph) {
         add_edge(edge.first, edge.second);
     }
-    mine_patterns(edge);
+    pattern_count.add(count_matches(edge, view_of(nullptr, 0, nullptr), &profile));
+}
+
+
+void Mining::unmining(const std::pair<int, int>& edge, bool remove_from_graph) {
+    removed_count.add(count_matches(edge, view_of(nullptr, 0, nullptr), &profile));
+    if (remove_from_graph) {
+        remove_edge(edge.first, edge.second);
+    }
+}
+
+
+void Mining::apply_batch(const UpdateBatch& batch, UpdateBatch::CompactionStats* stats) {
+    BatchContext context;
+    if (!begin_batch(batch, context, stats)) return;
+
+    if (runtime && !(latency_budget_us > 0 && engine)) {
+        start_tasks(context);
+        {
+            std::unique_lock<std::mutex> lock(context.mutex);
+            context.done.wait(lock, [&context] { return context.finished; });
+        }
+        finish_tasks(context);
+    } else {
+        run_lanes(context.timeline, context.groups);
+    }
+    end_batch(context);
+}
+
+
+// Mine the whole batch against one snapshot holding all of its insertions;
+// the timeline hides whatever a given update would not have seen yet.
+bool Mining::begin_batch(const UpdateBatch& batch, BatchContext& context, UpdateBatch::CompactionStats* stats) {
+    context.net = batch.compact([this](int u, int v) { return has_edge(u, v); }, stats);
+    if (context.net.empty()) return false;
+
+    context.timeline = EdgeTimeline(context.net);
+    for (const EdgeUpdate& up : context.net) {
+        if (up.is_insert) add_edge(up.u, up.v);
+    }
+    tune(context.net, context.timeline);
+    context.groups = UpdateBatch::group_by_endpoint(context.net);
+    return true;
+}
+
+
+void Mining::end_batch(BatchContext& context) {
+    for (const EdgeUpdate& up : context.net) {
+        if (!up.is_insert) remove_edge(up.u, up.v);
+    }
+}
+
+
+void Mining::set_auto_tune(size_t top_k, size_t sample_updates, size_t check_interval) {
+    tuner.reset(new AutoTuner(top_k, sample_updates));
+    tune_check_interval = check_interval;
+}
+
+
+void Mining::tune(const std::vector<EdgeUpdate>& net, const EdgeTimeline& timeline) {
+    if (!tuner || !engine) return;
+
+    bool due = !tuned;
+    updates_since_check += net.size();
+    GraphStatistics stats;
+    if (due || updates_since_check >= tune_check_interval) {
+        updates_since_check = 0;
+        stats = GraphStatistics::sample(graph);
+        if (tuned && tuner->drifted(stats)) {
+            // rank the alternatives again for the graph as it is now
+            ScheduleCostModel model(stats);
+            CompiledPlan compiled = engine->get_plan().get_compiled();
+            engine.reset(new MatchEngine(*dag, &model, tuner->get_top_k(), &compiled));
+            engine->set_decomposition(decompose);
+            due = true;
+        }
+    }
+    if (!due) return;
+
+    // tune on the head of the batch, mined exactly as run_lanes() will
+    std::vector<std::pair<int, int>> edges;
+    std::vector<MatchView> views;
+    for (size_t i = 0; i < net.size() && i < tuner->get_sample_updates(); ++i) {
+        edges.push_back(std::make_pair(net[i].u, net[i].v));
+        views.push_back(view_of(&timeline, i, nullptr));
+    }
+    last_tuning = tuner->tune(*engine, edges, views);
+    tuner->set_baseline(stats);
+    tuned = true;
+
+    std::cout << "Auto-tune: " << last_tuning.configurations << " configurations on "
+              << last_tuning.sample_updates << " updates, " << last_tuning.initial_us << " us -> "
+              << last_tuning.best_us << " us" << std::endl;
+    if (!tuning_file.empty()) {
+        AutoTuner::save(tuning_file, engine->get_plan().get_config());
+    }
+}
+
+
+bool Mining::get_compiled_plan(CompiledPlan& plan) const {
+    if (!engine) return false;
+    plan = engine->get_plan().get_compiled();
+    plan.tuned = tuned;
+    return true;
+}
+
+
+void Mining::set_lane_threads(size_t fast, size_t heavy) {
+    lane_threads[static_cast<int>(UpdateLane::FAST)] = std::max<size_t>(1, fast);
+    lane_threads[static_cast<int>(UpdateLane::HEAVY)] = std::max<size_t>(1, heavy);
+}
+
+
+void Mining::set_latency_budget(double budget_us, size_t background_threads) {
+    if (budget_us > 0 && !(dag && !dag->get_schedules().empty())) {
+        std::cerr << "Latency SLO mode needs the DAG engine; mining without a budget" << std::endl;
+        budget_us = 0;
+    }
+    latency_budget_us = budget_us;
+    completion_threads = std::max<size_t>(1, background_threads);
+}
+
+
+void Mining::set_threads(size_t threads) {
+    runtime_threads = threads;
+    runtime = nullptr;
+    if (threads == 0) return;
+
+    runtime = &TaskManager::getPool("mining-" + std::to_string(threads));
+    runtime->setOverflowPolicy(BLOCK);
+    runtime->start();
+    std::lock_guard<std::mutex> lock(mining_pools_mutex);
+    if (mining_pools.insert(threads).second) {
+        for (size_t i = 0; i < threads; ++i) {
+            runtime->addCustomer(std::make_shared<MiningWorker>("mining-" + std::to_string(i), i));
+        }
+    }
+}
+
+
+// Hands a result to the callback as soon as it is known; the output file
+// gets a batch's final results in net-update order from run_lanes().
+void Mining::emit(const UpdateResult& result) {
+    if (!result_callback) return;
+    std::lock_guard<std::mutex> lock(result_mutex);
+    result_callback(result);
+}
+
+
+void Mining::run_lanes(const EdgeTimeline& timeline, const std::vector<EndpointGroup>& groups) {
+    struct Observation {
+        size_t deg_u;
+        size_t deg_v;
+        double elapsed_us;
+    };
+
+    struct WorkerResult {
+        size_t found;
+        size_t removed;
+        size_t deferred;
+        LaneStats stats;
+        MatchProfile profile;
+        std::vector<Observation> observations;
+    };
+
+    struct DeferredUpdate {
+        MatchCursor cursor;
+        EdgeUpdate update;
+        size_t index;
+    };
+
+    std::vector<size_t> lanes[2];
+    for (size_t g = 0; g < groups.size(); ++g) {
+        double estimate = 0;
+        for (const EdgeUpdate& up : groups[g].updates) {
+            estimate += router.estimate_us(adjacency(up.u).size(), adjacency(up.v).size());
+        }
+        lanes[static_cast<int>(router.route(estimate))].push_back(g);
+    }
+
+    const bool slo = latency_budget_us > 0 && engine;
+    const auto budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::micro>(latency_budget_us));
+
+    std::deque<DeferredUpdate> deferred;
+    std::mutex deferred_mutex;
+    std::condition_variable deferred_cv;
+    bool lanes_done = false;
+
+    auto batch_start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next[2];
+    std::vector<WorkerResult> results[2];
+    std::vector<WorkerResult> completions(slo ? completion_threads : 0,
+                                          WorkerResult{0, 0, 0, LaneStats(), MatchProfile(), {}});
+
+    // final results by net-update index, written out once the batch is done
+    size_t net_updates = 0;
+    for (const EndpointGroup& group : groups) net_updates += group.updates.size();
+    std::vector<UpdateResult> finals(result_file.is_open() ? net_updates : 0);
+
+    auto worker = [&](int lane, WorkerResult& result) {
+        while (true) {
+            size_t slot = next[lane].fetch_add(1);
+            if (slot >= lanes[lane].size()) break;
+            const EndpointGroup& group = groups[lanes[lane][slot]];
+
+            SharedEndpointCache cache;
+            cache.vertex = group.shared;
+            SharedEndpointCache* cache_ptr = group.updates.size() > 1 ? &cache : nullptr;
+
+            for (size_t k = 0; k < group.updates.size(); ++k) {
+                const EdgeUpdate& up = group.updates[k];
+                const std::pair<int, int> edge(up.u, up.v);
+                MatchView view = view_of(&timeline, group.first + k, cache_ptr);
+                auto begin = std::chrono::steady_clock::now();
+
+                size_t matches;
+                bool provisional = false;
+                if (slo) {
+                    MatchCursor cursor = engine->start(edge);
+                    provisional = !engine->resume(cursor, view, begin + budget);
+                    matches = cursor.count;
+                    if (!provisional) {
+                        result.profile.merge(cursor.profile);
+                    } else {
+                        std::lock_guard<std::mutex> lock(deferred_mutex);
+                        deferred.push_back(DeferredUpdate{std::move(cursor), up, group.first + k});
+                        deferred_cv.notify_one();
+                    }
+                } else {
+                    matches = count_matches(edge, view, &result.profile);
+                }
+                auto end = std::chrono::steady_clock::now();
+
+                if (provisional) {
+                    result.deferred++;
+                } else {
+                    (up.is_insert ? result.found : result.removed) += matches;
+                }
+                UpdateResult update_result{up.u, up.v, up.is_insert, matches, provisional};
+                emit(update_result);
+                if (!provisional && !finals.empty()) finals[group.first + k] = update_result;
+                result.stats.record(std::chrono::duration<double, std::micro>(end - batch_start).count());
+                result.observations.push_back({adjacency(up.u).size(), adjacency(up.v).size(),
+                                               std::chrono::duration<double, std::micro>(end - begin).count()});
+            }
+            result.stats.groups++;
+        }
+    };
+
+    // Deferred cursors are finished against the same snapshot, which stays
+    // untouched until every completion thread has drained the queue.
+    auto completer = [&](WorkerResult& result) {
+        while (true) {
+            std::unique_lock<std::mutex> lock(deferred_mutex);
+            deferred_cv.wait(lock, [&] { return !deferred.empty() || lanes_done; });
+            if (deferred.empty()) break;
+            DeferredUpdate item = std::move(deferred.front());
+            deferred.pop_front();
+            lock.unlock();
+
+            engine->resume(item.cursor, view_of(&timeline, item.index, nullptr));
+            (item.update.is_insert ? result.found : result.removed) += item.cursor.count;
+            result.profile.merge(item.cursor.profile);
+            UpdateResult update_result{item.update.u, item.update.v, item.update.is_insert, item.cursor.count, false};
+            emit(update_result);
+            if (!finals.empty()) finals[item.index] = update_result;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::thread> background;
+    for (auto& completion : completions) {
+        background.emplace_back(completer, std::ref(completion));
+    }
+    for (int lane = 0; lane < 2; ++lane) {
+        next[lane] = 0;
+        size_t n = lanes[lane].empty() ? 0 : std::min(lane_threads[lane], lanes[lane].size());
+        results[lane].resize(n, WorkerResult{0, 0, 0, LaneStats(), MatchProfile(), {}});
+        for (size_t t = 0; t < n; ++t) {
+            threads.emplace_back(worker, lane, std::ref(results[lane][t]));
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(deferred_mutex);
+        lanes_done = true;
+    }
+    deferred_cv.notify_all();
+    for (auto& t : background) {
+        t.join();
+    }
+
+    if (!finals.empty()) {
+        std::string text;
+        for (const UpdateResult& result : finals) format_result(result, text);
+        result_file << text;
+    }
+
+    for (int lane = 0; lane < 2; ++lane) {
+        lane_stats[lane].threads = lane_threads[lane];
+        for (const WorkerResult& result : results[lane]) {
+            pattern_count.add(result.found);
+            removed_count.add(result.removed);
+            deferred_count += result.deferred;
+            lane_stats[lane].merge(result.stats);
+            profile.merge(result.profile);
+            for (const Observation& obs : result.observations) {
+                router.observe(obs.deg_u, obs.deg_v, obs.elapsed_us);
+            }
+        }
+    }
+    for (const WorkerResult& result : completions) {
+        pattern_count.add(result.found);
+        removed_count.add(result.removed);
+        profile.merge(result.profile);
+    }
+}
+
+
+// Submits the tasks of a batch. Once they have all run, the last one submits
+// context.resume, or sets context.finished if there is none; the caller
+// must not touch the context after this returns.
+void Mining::start_tasks(BatchContext& batch) {
+    const std::vector<EndpointGroup>& groups = batch.groups;
+    const size_t branches = engine ? engine->branches() : 1;
+    batch.lane.resize(groups.size());
+    batch.caches.resize(groups.size());
+    batch.profiles.assign(runtime_threads, MatchProfile());
+    batch.stats.assign(2 * runtime_threads, LaneStats());
+    batch.remaining.reset(new std::atomic<size_t>[groups.size()]);
+    batch.matches.reset(new std::atomic<size_t>[batch.net.size()]());
+    batch.elapsed_ns.reset(new std::atomic<uint64_t>[batch.net.size()]());
+    batch.pending = groups.size() * branches + 1;
+    batch.finished = false;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        double estimate = 0;
+        for (const EdgeUpdate& up : groups[g].updates) {
+            estimate += router.estimate_us(adjacency(up.u).size(), adjacency(up.v).size());
+        }
+        batch.lane[g] = static_cast<int>(router.route(estimate));
+        batch.remaining[g] = branches;
+
+        // The branch tasks of a group share its cache, so it is filled here,
+        // once, with the sets every update of the group reads: those of the
+        // shared endpoint and each other endpoint.
+        if (groups[g].updates.size() > 1) {
+            std::unique_ptr<SharedEndpointCache> cache(new SharedEndpointCache());
+            cache->vertex = groups[g].shared;
+            std::unordered_set<int> scratch;
+            for (const EdgeUpdate& up : groups[g].updates) {
+                common_neighbors(up.u, up.v, scratch, cache.get());
+            }
+            batch.caches[g] = std::move(cache);
+        }
+    }
+
+    // Heavy groups go in at background priority, so the workers finish the
+    // cheap ones first. The pool blocks this thread while its queues are
+    // full, which in turn holds back the stages feeding it.
+    batch.start = std::chrono::steady_clock::now();
+    BatchContext* context = &batch;
+    for (int lane = 0; lane < 2; ++lane) {
+        const int priority = lane == static_cast<int>(UpdateLane::HEAVY) ? -1 : 0;
+        for (size_t g = 0; g < groups.size(); ++g) {
+            if (batch.lane[g] != lane) continue;
+            for (size_t b = 0; b < branches; ++b) {
+                runtime->submitTask(TaskItem::make([this, context, g, b] { mine_branch(*context, g, b); }, priority));
+            }
+        }
+    }
+    batch.release(*runtime);
+}
+
+
+// Reduces what the workers observed while running the tasks of a batch.
+void Mining::finish_tasks(BatchContext& batch) {
+    for (int lane = 0; lane < 2; ++lane) {
+        lane_stats[lane].threads = runtime_threads;
+    }
+    for (size_t w = 0; w < runtime_threads; ++w) {
+        profile.merge(batch.profiles[w]);
+        for (int lane = 0; lane < 2; ++lane) {
+            lane_stats[lane].merge(batch.stats[2 * w + lane]);
+        }
+    }
+    for (size_t i = 0; i < batch.net.size(); ++i) {
+        const EdgeUpdate& up = batch.net[i];
+        router.observe(adjacency(up.u).size(), adjacency(up.v).size(), batch.elapsed_ns[i] / 1000.0);
+    }
+}
+
+
+// One task: one branch of the plan for every update of a group. Counts go
+// straight to the sharded totals; the last branch of a group to finish
+// reports its updates.
+void Mining::mine_branch(BatchContext& batch, size_t g, size_t branch) {
+    const size_t worker = static_cast<MiningWorker*>(Customer::current())->index;
+    const EndpointGroup& group = batch.groups[g];
+
+    SharedEndpointCache cache;
+    cache.vertex = group.shared;
+    cache.shared = batch.caches[g].get();
+    SharedEndpointCache* cache_ptr = cache.shared ? &cache : nullptr;
+
+    for (size_t k = 0; k < group.updates.size(); ++k) {
+        const EdgeUpdate& up = group.updates[k];
+        const std::pair<int, int> edge(up.u, up.v);
+        const size_t index = group.first + k;
+        MatchView view = view_of(&batch.timeline, index, cache_ptr);
+        auto begin = std::chrono::steady_clock::now();
+        size_t matches = engine ? engine->count_branch(edge, view, branch, &batch.profiles[worker])
+                                : mine_patterns(edge, view);
+        auto end = std::chrono::steady_clock::now();
+
+        (up.is_insert ? pattern_count : removed_count).add(matches);
+        batch.matches[index].fetch_add(matches);
+        batch.elapsed_ns[index].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    }
+
+    if (batch.remaining[g].fetch_sub(1) == 1) {
+        LaneStats& stats = batch.stats[2 * worker + batch.lane[g]];
+        double latency_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - batch.start).count();
+        for (size_t k = 0; k < group.updates.size(); ++k) {
+            const EdgeUpdate& up = group.updates[k];
+            emit(UpdateResult{up.u, up.v, up.is_insert, batch.matches[group.first + k].load(), false});
+            stats.record(latency_us);
+        }
+        stats.groups++;
+    }
+
+    batch.release(*runtime);
+}
+
+
+void Mining::print_lane_stats() const {
+    const char* names[2] = {"fast", "heavy"};
+    for (int lane = 0; lane < 2; ++lane) {
+        const LaneStats& st = lane_stats[lane];
+        std::cout << "Lane " << names[lane] << " (" << st.threads << " threads): "
+                  << st.updates << " updates in " << st.groups << " groups, latency mean "
+                  << st.mean_latency_us() << " us, p50 " << st.percentile_us(0.5)
+                  << " us, p99 " << st.percentile_us(0.99) << " us, max "
+                  << st.max_latency_us << " us" << std::endl;
+    }
 }
 
 
@@ -70,6 +667,7 @@ bool Mining::initialize() {
     }
 
     clear();
+    sorted_graph.reset();
 
     std::ifstream graph_file(graph_file_path);
     if (!graph_file.is_open()) {
@@ -89,163 +687,509 @@ bool Mining::initialize() {
 
     std::cout << "Loaded graph with " << node_count() << " nodes and " 
               << edge_count() << " edges" << std::endl;
+    if (leapfrog) sorted_graph.reset(new SortedAdjacency(graph));
+
+    // schedules are ranked against the graph just loaded
+    if (engine) {
+        GraphStatistics stats = GraphStatistics::sample(graph);
+        ScheduleCostModel model(stats);
+        // orders and restrictions carry over from the plan built with the DAG
+        CompiledPlan compiled = engine->get_plan().get_compiled();
+        engine.reset(new MatchEngine(*dag, &model, tuner ? tuner->get_top_k() : 1, &compiled));
+        if (decompose) {
+            size_t joined = engine->set_decomposition(true);
+            std::cout << "Joining " << joined << " of " << engine->get_plan().get_schedules().size()
+                      << " schedules on vertex separators" << std::endl;
+        }
+
+        tuned = false;
+        updates_since_check = 0;
+        MatchConfig config;
+        if (compiled_config && engine->configure(*compiled_config)) {
+            if (tuner) tuner->set_baseline(stats);
+            tuned = true;
+            std::cout << "Using the tuned configuration of the compiled plan" << std::endl;
+        } else if (tuner && !tuning_file.empty() && AutoTuner::load(tuning_file, config)) {
+            if (engine->configure(config)) {
+                tuner->set_baseline(stats);
+                tuned = true;
+                std::cout << "Loaded tuned plan from " << tuning_file << std::endl;
+            } else {
+                std::cerr << "Ignoring tuning file for another pattern: " << tuning_file << std::endl;
+            }
+        }
+        if (leapfrog && !tuned) {
+            config = engine->get_plan().get_config();
+            config.kernel = IntersectionKernel::LEAPFROG;
+            engine->configure(config);
+        }
+    }
+
+    reset_count();
+    static_count = 0;
+    if (static_threads > 0) {
+        auto start = std::chrono::high_resolution_clock::now();
+        static_count = count_static();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::cout << "Static count: " << static_count << " matches in "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()
+                  << " microseconds (" << static_threads << " threads)" << std::endl;
+    }
+    pattern_count.set(static_count);
     return true;
 }
 
-void Mining::mine_patterns(const std::pair<int, int>& edge) {
-    auto Nv0 = neighborhood(edge.first);
-    auto Nv1 = neighborhood(edge.second);
-    
 
-    Nv0.erase(edge.second);
-    Nv1.erase(edge.first);
+size_t Mining::count_static() const {
+    // Rank the edges and mine each one as if it were inserted in rank order:
+    // a match is counted only at its highest-ranked edge, where every other
+    // edge of it is visible, so the per-edge counts add up to the total.
+    std::vector<EdgeUpdate> edges;
+    edges.reserve(edge_count());
+    for (const auto& entry : graph) {
+        for (int v : entry.second) {
+            if (entry.first < v) edges.push_back(EdgeUpdate{entry.first, v, true});
+        }
+    }
+    const EdgeTimeline timeline(edges);
+
+    const size_t chunk = 64;
+    size_t n = std::min(static_threads, (edges.size() + chunk - 1) / chunk);
+    std::atomic<size_t> next(0);
+    std::vector<size_t> counts(std::max<size_t>(n, 1), 0);
+
+    auto worker = [&](size_t t) {
+        size_t local = 0;
+        while (true) {
+            size_t begin = next.fetch_add(chunk);
+            if (begin >= edges.size()) break;
+            size_t end = std::min(edges.size(), begin + chunk);
+            for (size_t i = begin; i < end; ++i) {
+                local += count_matches(std::make_pair(edges[i].u, edges[i].v), view_of(&timeline, i, nullptr));
+            }
+        }
+        counts[t] = local;
+    };
 
-    std::unordered_set<int> v2;
-    for (int v : Nv0) {
-        if (Nv1.find(v) != Nv1.end()) {
-            v2.insert(v);
+    if (n <= 1) {
+        worker(0);
+    } else {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < n; ++t) {
+            threads.emplace_back(worker, t);
+        }
+        for (auto& t : threads) {
+            t.join();
         }
     }
 
+    size_t total = 0;
+    for (size_t c : counts) total += c;
+    return total;
+}
+
+size_t Mining::count_matches(const std::pair<int, int>& edge, const MatchView& view, MatchProfile* profile) const {
+    if (engine) {
+        if (frontier_budget > 0) return engine->count_frontier(edge, view, frontier_budget, profile);
+        return engine->count(edge, view, profile);
+    }
+    return mine_patterns(edge, view);
+}
+
+
+size_t Mining::mine_patterns(const std::pair<int, int>& edge, const MatchView& ctx) const {
+    size_t count = 0;
+    const int e0 = edge.first;
+    const int e1 = edge.second;
+
+    const auto& Nv0 = adjacency(e0);
+    const auto& Nv1 = adjacency(e1);
+    auto common = [&ctx](int a, int b, int x) { return ctx.visible(a, x) && ctx.visible(b, x); };
+
+    std::unordered_set<int> v2_buf, cn_buf, cn_buf2;
+    const auto& v2 = common_neighbors(e0, e1, v2_buf, ctx.cache);
+
     for (int node : v2) {
+        if (!common(e0, e1, node)) continue;
         for (int i : Nv1) {
-            if (i != node) {
-                auto Nv3 = neighborhood(i);
-                Nv3.erase(edge.second);
-
-                std::unordered_set<int> Cv4;
-                for (int v : Nv0) {
-                    if (v != node && Nv3.find(v) != Nv3.end()) {
-                        Cv4.insert(v);
-                    }
-                }
-                
-                for (int s : Cv4) {
-                    process({edge.first, edge.second, node, i, s});
-                }
+            if (i == e0 || i == node || !ctx.visible(e1, i)) continue;
+
+            const auto& Cv4 = common_neighbors(e0, i, cn_buf, ctx.cache);
+            for (int s : Cv4) {
+                if (s == e1 || s == node || !common(e0, i, s)) continue;
+                process({e0, e1, node, i, s}, count);
             }
         }
     }
 
     for (int node : v2) {
-        auto Nv2 = neighborhood(node);
-        Nv2.erase(edge.first);
-        Nv2.erase(edge.second);
-        
+        if (!common(e0, e1, node)) continue;
         for (int i : Nv0) {
-            if (i != node) {
-                auto Nv3 = neighborhood(i);
-                
-                std::unordered_set<int> Cv4;
-                for (int v : Nv2) {
-                    if (Nv3.find(v) != Nv3.end()) {
-                        Cv4.insert(v);
-                    }
-                }
-                
-                for (int s : Cv4) {
-                    process({node, edge.first, edge.second, i, s});
-                }
+            if (i == e1 || i == node || !ctx.visible(e0, i)) continue;
+
+            const auto& Cv4 = common_neighbors(node, i, cn_buf, ctx.cache);
+            for (int s : Cv4) {
+                if (s == e0 || s == e1 || !common(node, i, s)) continue;
+                process({node, e0, e1, i, s}, count);
             }
         }
     }
 
     for (int node : Nv0) {
-        auto Nv3 = neighborhood(node);
-        Nv3.erase(edge.first);
-        Nv3.erase(edge.second);
-        
-        std::unordered_set<int> Cv3;
-        for (int v : Nv1) {
-            if (Nv3.find(v) != Nv3.end()) {
-                Cv3.insert(v);
-            }
-        }
-        
-        std::unordered_set<int> Cv4;
-        for (int v : Nv0) {
-            if (Nv3.find(v) != Nv3.end()) {
-                Cv4.insert(v);
+        if (node == e1 || !ctx.visible(e0, node)) continue;
+
+        const auto& Cv3 = common_neighbors(e1, node, cn_buf, ctx.cache);
+        const auto& Cv4 = common_neighbors(e0, node, cn_buf2, ctx.cache);
+        for (int i : Cv3) {
+            if (i == e0 || !common(e1, node, i)) continue;
+            for (int s : Cv4) {
+                if (s == e1 || i == s || !common(e0, node, s)) continue;
+                process({e0, e1, node, i, s}, count);
             }
         }
-        
+    }
+
+    for (int node : Nv0) {
+        if (node == e1 || !ctx.visible(e0, node)) continue;
+
+        const auto& Cv3 = common_neighbors(e1, node, cn_buf, ctx.cache);
         for (int i : Cv3) {
+            if (i == e0 || !common(e1, node, i)) continue;
+
+            std::unordered_set<int> Cv4_buf;
+            const auto& Cv4 = common_neighbors(node, i, Cv4_buf, ctx.cache);
             for (int s : Cv4) {
-                if (i != s) {
-                    process({edge.first, edge.second, node, i, s});
-                }
+                if (s == e1 || !common(node, i, s)) continue;
+                process({e0, node, s, i, e1}, count);
             }
         }
     }
+    return count;
+}
 
-    for (int node : Nv0) {
-        auto Nv2 = neighborhood(node);
-        Nv2.erase(edge.second);
-        
-        std::unordered_set<int> Cv3;
-        for (int v : Nv1) {
-            if (Nv2.find(v) != Nv2.end()) {
-                Cv3.insert(v);
+// run() in task runtime mode. Ingest parses the update file into batches,
+// Mine applies them one at a time, each as the tasks of start_tasks(), and
+// Sink writes the results. All three are Stages on the mining pool, and
+// the channels between them hold read_ahead batches: reading runs ahead of
+// mining, and writing behind it, by at most that much.
+struct Mining::Pipeline {
+    // Reads the update file a chunk at a time and sends a batch every
+    // batch_size updates, and the rest at the end, so batches are the same
+    // as the serial path's however the input arrives. A pipe that runs dry
+    // leaves the stage with the Reactor until there is more to read.
+    class Ingest : public Stage {
+    public:
+        Ingest(Pipeline& pipeline, int fd)
+            : Stage(*pipeline.mining.runtime), pipeline(pipeline), fd(fd), buffer(1 << 16), parsed(0),
+              at_end(false) {}
+
+    protected:
+        void resume() override {
+            if (!outgoing.empty() && !pipeline.updates.trySend(outgoing, resumeTask())) return;
+            outgoing.clear();
+            if (at_end) {
+                pipeline.updates.close();
+                return;
+            }
+
+            if (!take_lines()) {
+                ssize_t n = read(fd, buffer.data(), buffer.size());
+                if (n > 0 || (n < 0 && errno == EINTR)) {
+                    if (n > 0) text.append(buffer.data(), n);
+                    schedule();
+                    return;
+                }
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    awaitReady(fd, POLLIN);
+                    return;
+                }
+                if (n < 0) std::cerr << "Failed to read updates: " << std::strerror(errno) << std::endl;
+                text += '\n';      // the last line may lack one
+                take_lines();
+                at_end = true;
             }
+            outgoing.swap(batch);
+            schedule();
         }
-        
-        for (int i : Cv3) {
-            auto Nv3 = neighborhood(i);
-            
-            std::unordered_set<int> Cv4;
-            for (int v : Nv2) {
-                if (Nv3.find(v) != Nv3.end()) {
-                    Cv4.insert(v);
+
+    private:
+        // Parses whole lines of text into batch; true once it is full.
+        bool take_lines() {
+            while (batch.size() < pipeline.mining.batch_size) {
+                size_t end = text.find('\n', parsed);
+                if (end == std::string::npos) {
+                    text.erase(0, parsed);
+                    parsed = 0;
+                    return false;
                 }
+                EdgeUpdate up;
+                if (UpdateBatch::parse_line(text.substr(parsed, end - parsed), up)) batch.push_back(up);
+                parsed = end + 1;
             }
-            
-            for (int s : Cv4) {
-                process({edge.first, node, s, i, edge.second});
+            return true;
+        }
+
+        Pipeline& pipeline;
+        int fd;
+        std::vector<char> buffer;
+        std::string text;                   // read but not yet parsed from parsed on
+        size_t parsed;
+        std::vector<EdgeUpdate> batch;
+        std::vector<EdgeUpdate> outgoing;   // waiting for room in the channel
+        bool at_end;
+    };
+
+    // Applies one batch at a time: adds its insertions to the graph, waits
+    // for its tasks without holding a worker, then removes its deletions and
+    // sends the count of every net update on.
+    class Mine : public Stage {
+    public:
+        explicit Mine(Pipeline& pipeline) : Stage(*pipeline.mining.runtime), pipeline(pipeline), state(RECEIVING) {}
+
+    protected:
+        void resume() override {
+            Mining& mining = pipeline.mining;
+            if (state == MINING) {
+                mining.finish_tasks(*batch);
+                mining.end_batch(*batch);
+                for (size_t i = 0; i < batch->net.size(); ++i) {
+                    const EdgeUpdate& up = batch->net[i];
+                    results.push_back(UpdateResult{up.u, up.v, up.is_insert, batch->matches[i].load(), false});
+                }
+                batch.reset();
+                state = SENDING;
             }
+            if (state == SENDING) {
+                if (!pipeline.results.trySend(results, resumeTask())) return;
+                results.clear();
+                state = RECEIVING;
+                schedule();
+                return;
+            }
+
+            std::vector<EdgeUpdate> updates;
+            bool drained;
+            if (!pipeline.updates.tryReceive(updates, resumeTask(), drained)) {
+                if (drained) pipeline.results.close();
+                return;
+            }
+            std::cout << "Processed updates: " << pipeline.processed << std::endl;
+            pipeline.processed += updates.size();
+
+            batch.reset(new BatchContext);
+            UpdateBatch::CompactionStats stats;
+            bool mined = mining.begin_batch(UpdateBatch(updates.begin(), updates.end()), *batch, &stats);
+            add_stats(pipeline.total, stats);
+            if (!mined) {
+                schedule();
+                return;
+            }
+            // the last task resumes this stage, possibly before start_tasks returns
+            state = MINING;
+            batch->resume = resumeTask();
+            mining.start_tasks(*batch);
         }
+
+    private:
+        enum State { RECEIVING, MINING, SENDING };
+
+        Pipeline& pipeline;
+        State state;
+        std::unique_ptr<BatchContext> batch;
+        std::vector<UpdateResult> results;
+    };
+
+    // Writes the results of each batch to the output file, if there is one.
+    class Sink : public Stage {
+    public:
+        Sink(Pipeline& pipeline, int fd) : Stage(*pipeline.mining.runtime), pipeline(pipeline), fd(fd), written(0) {}
+
+    protected:
+        void resume() override {
+            while (written < text.size()) {
+                ssize_t n = write(fd, text.data() + written, text.size() - written);
+                if (n >= 0) {
+                    written += n;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    awaitReady(fd, POLLOUT);
+                    return;
+                } else if (errno != EINTR) {
+                    std::cerr << "Failed to write results: " << std::strerror(errno) << std::endl;
+                    fd = -1;
+                    break;
+                }
+            }
+            text.clear();
+            written = 0;
+
+            std::vector<UpdateResult> results;
+            bool drained;
+            if (!pipeline.results.tryReceive(results, resumeTask(), drained)) {
+                if (drained) pipeline.finish();
+                return;
+            }
+            if (fd >= 0) {
+                for (const UpdateResult& result : results) format_result(result, text);
+            }
+            schedule();
+        }
+
+    private:
+        Pipeline& pipeline;
+        int fd;
+        std::string text;
+        size_t written;
+    };
+
+    Pipeline(Mining& mining, int update_fd, int output_fd, UpdateBatch::CompactionStats& total)
+        : mining(mining), updates(*mining.runtime, read_ahead), results(*mining.runtime, read_ahead),
+          ingest(*this, update_fd), mine(*this), sink(*this, output_fd), total(total), processed(0),
+          finished(false) {}
+
+    void finish() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        done.notify_all();
     }
+
+    Mining& mining;
+    Channel<std::vector<EdgeUpdate>> updates;
+    Channel<std::vector<UpdateResult>> results;
+    Ingest ingest;
+    Mine mine;
+    Sink sink;
+    UpdateBatch::CompactionStats& total;    // written by Mine only
+    size_t processed;
+    bool finished;                          // under mutex
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+
+void Mining::run_pipeline(int update_fd, UpdateBatch::CompactionStats& total) {
+    int output_fd = -1;
+    if (!output_file_path.empty()) {
+        output_fd = open(output_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (output_fd < 0) {
+            std::cerr << "Failed to open output file: " << output_file_path << std::endl;
+        } else {
+            fcntl(output_fd, F_SETFL, fcntl(output_fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+
+    Pipeline pipeline(*this, update_fd, output_fd, total);
+    pipeline.ingest.schedule();
+    pipeline.mine.schedule();
+    pipeline.sink.schedule();
+    {
+        std::unique_lock<std::mutex> lock(pipeline.mutex);
+        pipeline.done.wait(lock, [&pipeline] { return pipeline.finished; });
+    }
+    if (output_fd >= 0) close(output_fd);
 }
 
+
 void Mining::run() {
     if (update_file_path.empty()) {
         std::cerr << "Update file path not set!" << std::endl;
         return;
     }
 
-    std::ifstream update_file(update_file_path);
-    if (!update_file.is_open()) {
-        std::cerr << "Failed to open update file: " << update_file_path << std::endl;
-        return;
-    }
+    reset_count();
+    pattern_count.set(static_count);
+    lane_stats[0] = LaneStats();
+    lane_stats[1] = LaneStats();
+    profile = MatchProfile();
+    UpdateBatch::CompactionStats total = {0, 0, 0, 0, 0};
+    // the pool outlives this run, so its workers are reported from here on
+    std::vector<WorkerStats> workers_before;
+    if (runtime) workers_before = runtime->getStats();
+    auto start = std::chrono::high_resolution_clock::now();
 
-    std::vector<std::pair<int, int>> updates;
-    std::string line;
-    while (std::getline(update_file, line)) {
-        std::istringstream iss(line);
-        int u, v;
-        if (iss >> u >> v) {
-            updates.emplace_back(u, v);
+    if (runtime && !(latency_budget_us > 0 && engine)) {
+        // a pipe stays blocking until its writer has opened it
+        int update_fd = open(update_file_path.c_str(), O_RDONLY);
+        if (update_fd < 0) {
+            std::cerr << "Failed to open update file: " << update_file_path << std::endl;
+            return;
+        }
+        fcntl(update_fd, F_SETFL, fcntl(update_fd, F_GETFL) | O_NONBLOCK);
+        std::cout << "Processing updates on " << runtime_threads << " threads..." << std::endl;
+        run_pipeline(update_fd, total);
+        close(update_fd);
+    } else {
+        std::ifstream update_file(update_file_path);
+        if (!update_file.is_open()) {
+            std::cerr << "Failed to open update file: " << update_file_path << std::endl;
+            return;
+        }
+        if (!output_file_path.empty()) {
+            result_file.open(output_file_path);
+            if (!result_file.is_open()) {
+                std::cerr << "Failed to open output file: " << output_file_path << std::endl;
+            }
         }
-    }
-    update_file.close();
-
-    std::cout << "Processing " << updates.size() << " updates..." << std::endl;
 
-    pattern_count = 0;
-    auto start = std::chrono::high_resolution_clock::now();
+        std::vector<EdgeUpdate> updates;
+        std::string line;
+        while (std::getline(update_file, line)) {
+            EdgeUpdate up;
+            if (UpdateBatch::parse_line(line, up)) {
+                updates.push_back(up);
+            }
+        }
+        update_file.close();
 
-    for (size_t i = 0; i < updates.size(); ++i) {
-        if (i < 1000 && i % 100 == 0 || i % 1000 == 0) {
+        std::cout << "Processing " << updates.size() << " updates..." << std::endl;
+        for (size_t i = 0; i < updates.size(); i += batch_size) {
             std::cout << "Processed updates: " << i << " / " << updates.size() << std::endl;
+            size_t end = std::min(updates.size(), i + batch_size);
+            UpdateBatch::CompactionStats stats;
+            apply_batch(UpdateBatch(updates.begin() + i, updates.begin() + end), &stats);
+            add_stats(total, stats);
         }
-        mining(updates[i], true);
+        result_file.close();
     }
 
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     std::cout << "Mining completed in " << duration.count() << " microseconds" << std::endl;
+    std::cout << "Net updates mined: " << total.net_updates << " (self-loops: " << total.self_loops
+              << ", redundant: " << total.redundant << ", cancelled: " << total.cancelled << ")" << std::endl;
 
     std::cout << "\nMining Results:" << std::endl;
-    std::cout << "Total matches found: " << pattern_count << std::endl;
-}
-
+    if (static_count > 0) {
+        std::cout << "Matches in initial graph: " << static_count << std::endl;
+    }
+    std::cout << "Total matches found: " << pattern_count.get() - static_count << std::endl;
+    if (removed_count.get() > 0) {
+        std::cout << "Total matches removed: " << removed_count.get() << std::endl;
+    }
+    if (static_threads > 0) {
+        std::cout << "Current match count: " << get_total_count() << std::endl;
+    }
+    if (deferred_count > 0) {
+        std::cout << "Updates completed after a provisional result: " << deferred_count << std::endl;
+    }
+    print_lane_stats();
+    if (runtime) {
+        std::vector<WorkerStats> workers = runtime->getStats();
+        for (size_t w = 0; w < workers.size(); ++w) {
+            WorkerStats stats = w < workers_before.size() ? workers[w].since(workers_before[w]) : workers[w];
+            std::cout << "Worker " << stats.id << ": " << stats.tasks_executed << " tasks, " << stats.steals
+                      << " stolen, " << stats.failed_steals << " failed steals, busy " << stats.busy_ms
+                      << " ms, parked " << stats.parked_ms << " ms" << std::endl;
+        }
+    }
+    if (engine) {
+        engine->get_plan().print(&profile);
+        if (total.net_updates > 0) {
+            size_t unshared = 0;
+            for (size_t e : profile.expansions) unshared += e;
+            std::cout << "Intersections per update: "
+                      << static_cast<double>(profile.intersections) / total.net_updates << " ("
+                      << static_cast<double>(unshared) / total.net_updates << " without schedule merging)"
+                      << std::endl;
+        }
+    }
+}
\ No newline at end of file
@@ -6,11 +6,9 @@
 #include <cstdio>
 #include <algorithm>
 
-Pattern::Pattern(int _size, bool clique)
+Pattern::Pattern(int _size, bool clique) : adj(_size)
 {
     size = _size;
-    adj_mat = new int[size * size];
-    memset(adj_mat, 0, size * size * sizeof(int));
 
     if( clique ) {
         for(int i = 0; i < size; ++i)
@@ -19,10 +17,8 @@ Pattern::Pattern(int _size, bool clique)
     }
 }
 
-Pattern::Pattern(int _size, char *buffer) {
+Pattern::Pattern(int _size, char *buffer) : adj(_size) {
     size = _size;
-    adj_mat = new int[size * size];
-    memset(adj_mat, 0, size * size * sizeof(int));
 
     for(int i = 0; i < size; ++i)
         for(int j = 0; j < size; ++j)
@@ -30,23 +26,10 @@ Pattern::Pattern(int _size, char *buffer) {
                 add_edge(i,j);
 }
 
-Pattern::~Pattern()
-{
-    delete[] adj_mat;
-}
-
-Pattern::Pattern(const Pattern& p)
-{
-    size = p.get_size();
-    adj_mat = new int[size * size];
-    memcpy(adj_mat, p.get_adj_mat_ptr(), size * size * sizeof(int));
-}
-
 Pattern::Pattern(PatternType type) {
     if( type == PatternType::Rectangle) {
         size = 4;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         add_edge(0, 1);
         add_edge(0, 2);
         add_edge(1, 3);
@@ -55,8 +38,7 @@ Pattern::Pattern(PatternType type) {
     }
     if( type == PatternType::QG3) {
         size = 4;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         add_edge(0, 1);
         add_edge(0, 2);
         add_edge(0, 3);
@@ -66,8 +48,7 @@ Pattern::Pattern(PatternType type) {
     }
     if( type == PatternType::Pentagon) {
         size = 5;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         add_edge(0, 1);
         add_edge(0, 2);
         add_edge(1, 3);
@@ -77,8 +58,7 @@ Pattern::Pattern(PatternType type) {
     }
     if( type == PatternType::House) {
         size = 5;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         add_edge(0, 1);
         add_edge(0, 2);
         add_edge(0, 3);
@@ -89,8 +69,7 @@ Pattern::Pattern(PatternType type) {
     }
     if( type == PatternType::Hourglass) {
         size = 6;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         add_edge(0, 1);
         add_edge(0, 2);
         add_edge(0, 4);
@@ -104,8 +83,7 @@ Pattern::Pattern(PatternType type) {
     }
     if( type == PatternType::Cycle_6_Tri) {
         size = 6;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         add_edge(0, 1);
         add_edge(0, 2);
         add_edge(1, 2);
@@ -119,8 +97,7 @@ Pattern::Pattern(PatternType type) {
     }
     if( type == PatternType::Clique_7_Minus) {
         size = 7;
-        adj_mat = new int[size * size];
-        memset(adj_mat, 0, size * size * sizeof(int));
+        adj = Adjacency(size);
         for(int i = 0; i < size; ++i)
             for(int j = 0; j < i; ++j)
                 if( i != size - 1|| j != size - 2)
@@ -134,64 +111,45 @@ Pattern::Pattern(PatternType type) {
 
 void Pattern::add_edge(int x, int y)
 {
-    adj_mat[INDEX(x, y, size)] = 1;
-    adj_mat[INDEX(y, x, size)] = 1;
+    adj.add_edge(x, y);
 }
 
 void Pattern::del_edge(int x, int y)
 {
-    adj_mat[INDEX(x, y, size)] = 0;
-    adj_mat[INDEX(y, x, size)] = 0;
+    adj.del_edge(x, y);
 }
 
 bool Pattern::check_connected() const
 {
-    bool vis[size];
-    for (int i = 0; i < size; ++i)
-        vis[i] = false;
-    int que[size];
-    int head = 0;
-    int tail = 0;
-    que[0] = 0;
-    vis[0] = true;
-    //bfs
-    while (head <= tail)
+    if (size == 0)
+        return true;
+    // bfs over vertex masks
+    uint64_t all = size == 64 ? ~0ULL : (1ULL << size) - 1;
+    uint64_t visited = 1, frontier = 1;
+    while (frontier != 0)
     {
-        int x = que[head++];
-        for (int i = 0; i < size; ++i)
-            if (adj_mat[INDEX(x, i, size)] != 0 && vis[i] == false)
-            {
-                vis[i] = true;
-                que[++tail] = i;
-            }
+        uint64_t next = 0;
+        for (uint64_t m = frontier; m != 0; m &= m - 1)
+            next |= adj.row(__builtin_ctzll(m));
+        frontier = next & ~visited;
+        visited |= frontier;
     }
-    for (int i = 0; i < size; ++i)
-        if (vis[i] == false)
-            return false;
-    return true;
+    return visited == all;
 }
 
 
 void Pattern::count_all_isomorphism(std::set< std::set<int> >& s) const
 {
-    unsigned int pow = 1;
-    for (int i = 2; i <= size; ++i)
-        pow *= i;
-    std::vector< std::vector<int> > vec;
-    vec.clear();
-    bool use[size];
+    std::vector<int> v(size);
     for (int i = 0; i < size; ++i)
-        use[i] = false;
-    std::vector<int> tmp_vec;
-    get_full_permutation(vec, use, tmp_vec, 0);
-    assert(vec.size() == pow);
+        v[i] = i;
     std::set<int> edge_set;
-    for (const std::vector<int>& v : vec)
+    do
     {
         edge_set.clear();
         for (int i = 0; i < size; ++i)
             for (int j = i + 1; j < size; ++j)
-                if (adj_mat[INDEX(i, j, size)] != 0)
+                if (adj.has_edge(i, j))
                 {
                     if (v[i] < v[j])
                         edge_set.insert(v[i] * size + v[j]);
@@ -201,14 +159,14 @@ void Pattern::count_all_isomorphism(std::set< std::set<int> >& s) const
 
         if (s.count(edge_set) == 0)
             s.insert(edge_set);
-    }
+    } while (std::next_permutation(v.begin(), v.end()));
 }
 
 void Pattern::print() const
 {
     for (int i = 0; i < size; ++i)
         for (int j = 0; j < size; ++j)
-            if (adj_mat[INDEX(i, j, size)] != 0)
+            if (adj.has_edge(i, j))
                 printf("(%d,%d) ", i, j);
     printf("\n");
 }
@@ -244,52 +202,7 @@ void Pattern::print() const
 //         return false;
 // }
 
-void Pattern::get_full_permutation(std::vector< std::vector<int> >& vec, bool use[], std::vector<int> tmp_vec, int depth) const
-{
-    if (depth == size)
-    {
-        vec.push_back(tmp_vec);
-        return;
-    }
-    for (int i = 0; i < size; ++i)
-        if (use[i] == false)
-        {
-            use[i] = true;
-            tmp_vec.push_back(i);
-            get_full_permutation(vec, use, tmp_vec, depth + 1);
-            tmp_vec.pop_back();
-            use[i] = false;
-        }
-}
-
 std::vector< std::vector<int> > Pattern::get_isomorphism_vec() const
 {
-    unsigned int pow = 1;
-    for (int i = 2; i <= size; ++i)
-        pow *= i;
-    std::vector< std::vector<int> > vec;
-    vec.clear();
-    bool use[size];
-    for (int i = 0; i < size; ++i)
-        use[i] = false;
-    std::vector<int> tmp_vec;
-    get_full_permutation(vec, use, tmp_vec, 0);
-    assert(vec.size() == pow);
-    std::vector< std::vector<int> > isomorphism_vec;
-    isomorphism_vec.clear();
-    for (const std::vector<int>& v : vec)
-    {
-        bool flag = true;
-        for (int i = 0; i < size; ++i)
-            for (int j = i + 1; j < size; ++j)
-                if (adj_mat[INDEX(i, j, size)] != 0)
-                    if (adj_mat[INDEX(v[i], v[j], size)] == 0) // not isomorphism
-                    {
-                        flag = false;
-                        break;
-                    }
-        if (flag == true)
-            isomorphism_vec.push_back(v);
-    }
-    return isomorphism_vec;
+    return canonical_form().get_automorphisms();
 }
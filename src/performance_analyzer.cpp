@@ -5,7 +5,7 @@
 #include <chrono>
 
 PerformanceAnalyzer::PerformanceAnalyzer(const DAG& dag, const MonitoringConfig& config)
-    : dag_(dag), config_(config), is_monitoring_(false) {
+    : dag_(dag), config_(config), is_monitoring_(false), task_manager_(nullptr) {
 }
 
 void PerformanceAnalyzer::startMonitoring() {
@@ -15,6 +15,9 @@ void PerformanceAnalyzer::startMonitoring() {
         metrics_history_.clear();
         event_timestamps_.clear();
         vertex_metrics_.clear();
+        if (task_manager_) {
+            worker_baseline_ = task_manager_->getStats();
+        }
     }
 }
 
@@ -59,6 +62,11 @@ void PerformanceAnalyzer::markEventTimestamp(const std::string& event_name) {
     event_timestamps_[event_name] = std::chrono::steady_clock::now();
 }
 
+void PerformanceAnalyzer::monitorTaskManager(const TaskManager& pool) {
+    task_manager_ = &pool;
+    worker_baseline_ = pool.getStats();
+}
+
 PerformanceAnalyzer::PerformanceReport PerformanceAnalyzer::generateReport() const {
     PerformanceReport report;
     
@@ -98,7 +106,28 @@ PerformanceAnalyzer::PerformanceReport PerformanceAnalyzer::generateReport() con
         }
         report.vertex_metrics[vertex_id] = execution_times;
     }
-    
+
+    report.worker_stats = collectWorkerStats();
+    if (!report.worker_stats.empty()) {
+        double tasks = 0, max_tasks = 0, busy = 0, max_busy = 0, parked = 0, steals = 0, failed_steals = 0;
+        for (const auto& worker : report.worker_stats) {
+            tasks += worker.tasks_executed;
+            max_tasks = std::max(max_tasks, static_cast<double>(worker.tasks_executed));
+            busy += worker.busy_ms;
+            max_busy = std::max(max_busy, worker.busy_ms);
+            parked += worker.parked_ms;
+            steals += worker.steals;
+            failed_steals += worker.failed_steals;
+        }
+        double workers = report.worker_stats.size();
+        report.aggregated_metrics["worker_tasks_executed"] = tasks;
+        report.aggregated_metrics["worker_task_imbalance"] = tasks > 0 ? max_tasks * workers / tasks : 0;
+        report.aggregated_metrics["worker_busy_imbalance"] = busy > 0 ? max_busy * workers / busy : 0;
+        report.aggregated_metrics["worker_parked_fraction"] = busy + parked > 0 ? parked / (busy + parked) : 0;
+        report.aggregated_metrics["steal_success_rate"] =
+            steals + failed_steals > 0 ? steals / (steals + failed_steals) : 0;
+    }
+
     return report;
 }
 
@@ -145,7 +174,25 @@ std::vector<std::string> PerformanceAnalyzer::analyzeBottlenecks() const {
                                 " has high execution time");
         }
     }
-    
+
+    // a worker busy well past the mean is stuck with work the others could
+    // not steal, such as the updates of a hub vertex
+    auto workers = collectWorkerStats();
+    if (workers.size() > 1) {
+        double total_busy = 0;
+        const WorkerStats* busiest = &workers.front();
+        for (const auto& worker : workers) {
+            total_busy += worker.busy_ms;
+            if (worker.busy_ms > busiest->busy_ms) busiest = &worker;
+        }
+        double mean_busy = total_busy / workers.size();
+        if (mean_busy > 0 && busiest->busy_ms > 1.5 * mean_busy) {
+            bottlenecks.push_back("Load imbalance: worker " + busiest->id + " busy " +
+                                  std::to_string(static_cast<long long>(busiest->busy_ms)) + " ms against a mean of " +
+                                  std::to_string(static_cast<long long>(mean_busy)) + " ms");
+        }
+    }
+
     return bottlenecks;
 }
 
@@ -390,6 +437,17 @@ bool PerformanceAnalyzer::isResourceOverutilized(const std::string& resource_typ
     return false;
 }
 
+std::vector<WorkerStats> PerformanceAnalyzer::collectWorkerStats() const {
+    std::vector<WorkerStats> workers;
+    if (!task_manager_) return workers;
+
+    workers = task_manager_->getStats();
+    for (size_t i = 0; i < workers.size() && i < worker_baseline_.size(); ++i) {
+        workers[i] = workers[i].since(worker_baseline_[i]);
+    }
+    return workers;
+}
+
 std::vector<std::pair<int, int>> PerformanceAnalyzer::findConcurrentExecutions() const {
     std::vector<std::pair<int, int>> concurrent_pairs;
     
@@ -0,0 +1,148 @@
+#include "../include/plan_cache.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// File format, one item per line:
+//   plan <engine_version> <size>
+//   pattern <canonical adjacency matrix>
+//   schedule <adjacency matrix>            starts a schedule; the lines below belong to it
+//   order <v0> ... <vn-1>                  every valid order, as generated
+//   restrict <v0> ... <vn-1> <a b>...      restrictions of one compiled order
+//   tuned <kernel>                         optional, followed by
+//   choice <v0> ... <vn-1>                 the tuned order of each schedule
+std::string PlanCache::path_for(const Pattern& pattern) const {
+    std::ostringstream name;
+    name << directory << "/" << std::hex << pattern.canonical_form().get_hash() << std::dec
+         << "-v" << MatchPlan::engine_version << ".plan";
+    return name.str();
+}
+
+bool PlanCache::load(const Pattern& pattern, CompiledPlan& plan) const {
+    std::ifstream file(path_for(pattern));
+    if (!file.is_open()) return false;
+
+    const std::vector<int> canonical = pattern.canonical_form().get_matrix();
+    CompiledPlan loaded;
+    loaded.size = 0;
+    loaded.tuned = false;
+    loaded.config.kernel = IntersectionKernel::SMALLEST_SCAN;
+
+    auto read_ints = [](std::istringstream& iss) {
+        std::vector<int> values;
+        int v;
+        while (iss >> v) values.push_back(v);
+        return values;
+    };
+
+    std::string line;
+    bool header = false, same_pattern = false;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string key;
+        if (!(iss >> key)) continue;
+        const size_t n = loaded.size;
+        if (key == "plan") {
+            int version;
+            if (!(iss >> version >> loaded.size) || version != MatchPlan::engine_version || loaded.size <= 0) return false;
+            header = true;
+        } else if (!header) {
+            return false;
+        } else if (key == "pattern") {
+            same_pattern = read_ints(iss) == canonical;
+        } else if (key == "schedule") {
+            std::vector<int> matrix = read_ints(iss);
+            if (matrix.size() != n * n) return false;
+            loaded.matrices.push_back(matrix);
+            loaded.orders.push_back(std::vector<std::vector<int>>());
+            loaded.restrictions.push_back(std::map<std::vector<int>, Restrictions>());
+        } else if (key == "order") {
+            std::vector<int> order = read_ints(iss);
+            if (loaded.orders.empty() || order.size() != n) return false;
+            loaded.orders.back().push_back(order);
+        } else if (key == "restrict") {
+            std::vector<int> values = read_ints(iss);
+            if (loaded.restrictions.empty() || values.size() < n || (values.size() - n) % 2 != 0) return false;
+            Restrictions pairs;
+            for (size_t i = n; i < values.size(); i += 2) {
+                pairs.push_back(std::make_pair(values[i], values[i + 1]));
+            }
+            loaded.restrictions.back()[std::vector<int>(values.begin(), values.begin() + n)] = pairs;
+        } else if (key == "tuned") {
+            int k;
+            if (!(iss >> k) || k < 0 || k > static_cast<int>(IntersectionKernel::LEAPFROG)) return false;
+            loaded.tuned = true;
+            loaded.config.kernel = static_cast<IntersectionKernel>(k);
+        } else if (key == "choice") {
+            loaded.config.orders.push_back(read_ints(iss));
+        } else {
+            return false;
+        }
+    }
+    if (!same_pattern || loaded.matrices.empty()) return false;
+    if (loaded.tuned && loaded.config.orders.size() != loaded.matrices.size()) return false;
+
+    plan = loaded;
+    return true;
+}
+
+bool PlanCache::store(const Pattern& pattern, const CompiledPlan& plan) const {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Failed to create plan cache directory: " << directory << std::endl;
+        return false;
+    }
+
+    const std::string path = path_for(pattern);
+    const std::string temp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(temp);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write plan cache entry: " << temp << std::endl;
+            return false;
+        }
+        auto write_ints = [&file](const char* key, const std::vector<int>& values) {
+            file << key;
+            for (int v : values) file << " " << v;
+            file << "\n";
+        };
+
+        file << "plan " << MatchPlan::engine_version << " " << plan.size << "\n";
+        write_ints("pattern", pattern.canonical_form().get_matrix());
+        for (size_t s = 0; s < plan.matrices.size(); ++s) {
+            write_ints("schedule", plan.matrices[s]);
+            for (const std::vector<int>& order : plan.orders[s]) {
+                write_ints("order", order);
+            }
+            for (const auto& entry : plan.restrictions[s]) {
+                std::vector<int> values(entry.first);
+                for (const std::pair<int, int>& r : entry.second) {
+                    values.push_back(r.first);
+                    values.push_back(r.second);
+                }
+                write_ints("restrict", values);
+            }
+        }
+        if (plan.tuned) {
+            file << "tuned " << static_cast<int>(plan.config.kernel) << "\n";
+            for (const std::vector<int>& order : plan.config.orders) {
+                write_ints("choice", order);
+            }
+        }
+        if (!file) {
+            std::cerr << "Failed to write plan cache entry: " << temp << std::endl;
+            std::remove(temp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Failed to write plan cache entry: " << path << std::endl;
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
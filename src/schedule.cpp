@@ -6,106 +6,151 @@
 #include <vector>
 #include <cstdio>
 #include <iostream>
+#include <algorithm>
 
 
-Schedule::Schedule(std::vector<Mappings> &mappings, std::vector<bool> &is_unique) {
+Schedule::Schedule(std::vector<Mappings> &mappings, std::vector<bool> &is_unique) : size(0) {
     for(size_t i = 0; i < mappings.size(); ++i) {
         if (!is_unique[i]) continue;
     }
 }
 
-Schedule::Schedule(const int* _adj_mat, int _size) {
-    size = _size;
-    adj_mat = new int[size * size];
-    memset(adj_mat, 0, size * size * sizeof(int));
+Schedule::Schedule(const int* _adj_mat, int _size) : adj(_adj_mat, _size), size(_size) {
+}
 
-    for(int i = 0; i < size; ++i)
-        for(int j = 0; j < size; ++j)
-            if(_adj_mat[INDEX(i,j,size)] == 1)
-                add_edge(i, j);
-            else if (_adj_mat[INDEX(i,j,size)] == 2)
-                add_update_mapping(i, j);
+Schedule Schedule::generate_schedules() const{
+    int row1 = -1, row2 = -1;
+    for(int x = 0; x < size && row2 == -1; ++x) {
+        if(adj.marked_row(x) != 0) {
+            if(row1 == -1) row1 = x;
+            else row2 = x;
+        }
+    }
+
+    // same relabeling as swapping row_map[0] with row_map[row1], then
+    // row_map[1] with row_map[row2], and moving vertex x to row_map[x]
+    Schedule reordered(*this);
+    if(row1 != -1 && row2 != -1) {
+        reordered.adj.swap_vertices(1, row2);
+        reordered.adj.swap_vertices(0, row1);
+    }
+
+    // reordered.print_schedule();
+    return reordered;
+}
+
+bool Schedule::find_update_edge(int& x, int& y) const
+{
+    for(int i = 0; i < size; ++i) {
+        uint64_t later = adj.marked_row(i) & ~((2ULL << i) - 1);
+        if(later != 0) {
+            x = i;
+            y = __builtin_ctzll(later);
+            return true;
+        }
+    }
+    return false;
 }
 
-Schedule::~Schedule()
+std::vector< std::vector<int> > Schedule::generate_orders() const
 {
-    // delete[] adj_mat;
+    std::vector< std::vector<int> > orders;
+
+    int x, y;
+    if(!find_update_edge(x, y)) return orders;
+
+    // links[v]: number of edges from v into the current prefix
+    std::vector<int> links(size, 0);
+    std::vector<bool> placed(size, false);
+    std::vector<int> order;
+    for(int v : {x, y}) {
+        order.push_back(v);
+        placed[v] = true;
+        for(uint64_t m = adj.row(v); m != 0; m &= m - 1)
+            links[__builtin_ctzll(m)]++;
+    }
+    extend_orders(order, links, placed, orders);
+    return orders;
 }
 
-void Schedule::generate_schedules(int *reorderschedule) const{
-    const int* curr_adj = adj_mat;
+std::vector<int> Schedule::first_order() const
+{
+    // the backtracking of generate_orders() only dead-ends on disconnected
+    // schedules, so its first order is the greedy one
+    std::vector<int> order;
+    int x, y;
+    if(!find_update_edge(x, y)) return order;
+
+    std::vector<int> links(size, 0);
+    std::vector<bool> placed(size, false);
+    for(int v : {x, y}) {
+        order.push_back(v);
+        placed[v] = true;
+        for(uint64_t m = adj.row(v); m != 0; m &= m - 1)
+            links[__builtin_ctzll(m)]++;
+    }
+    while(static_cast<int>(order.size()) < size) {
+        int next = -1;
+        for(int v = 0; v < size; ++v)
+            if(!placed[v] && links[v] > 0 && (next < 0 || links[v] > links[next])) next = v;
+        if(next < 0) return std::vector<int>();
+        order.push_back(next);
+        placed[next] = true;
+        for(uint64_t m = adj.row(next); m != 0; m &= m - 1)
+            links[__builtin_ctzll(m)]++;
+    }
+    return order;
+}
 
-    int row1 = -1, row2 = -1;
-    for(int x = 0; x < size; ++x) {
-        for(int y = 0; y < size; ++y) {
-            if(curr_adj[INDEX(x, y, size)] == 2) {
-                if(row1 == -1) {
-                    row1 = x;
-                } else {
-                    row2 = x;
-                    break;
-                }
-            }
-        }
-        if(row2 != -1) break;
+void Schedule::extend_orders(std::vector<int>& order, std::vector<int>& links, std::vector<bool>& placed,
+                             std::vector< std::vector<int> >& orders) const
+{
+    if(static_cast<int>(order.size()) == size) {
+        orders.push_back(order);
+        return;
     }
 
-    int* new_adj = new int[size * size];
-    memset(new_adj, 0, size * size * sizeof(int));
+    int best = 0;
+    for(int v = 0; v < size; ++v)
+        if(!placed[v]) best = std::max(best, links[v]);
+    if(best == 0) return;   // the rest is not connected to the prefix
 
-    if(row1 != 0 || row2 != 1) {
+    for(int v = 0; v < size; ++v) {
+        if(placed[v] || links[v] != best) continue;
 
-        std::vector<int> row_map(size);
-        for(int i = 0; i < size; ++i) row_map[i] = i;
+        order.push_back(v);
+        placed[v] = true;
+        for(uint64_t m = adj.row(v); m != 0; m &= m - 1)
+            links[__builtin_ctzll(m)]++;
 
-        if(row1 != 0) {
-            std::swap(row_map[0], row_map[row1]);
-        }
-        if(row2 != 1) {
-            std::swap(row_map[1], row_map[row2]);
-        }
+        extend_orders(order, links, placed, orders);
 
-        for(int x = 0; x < size; ++x) {
-            for(int y = 0; y < size; ++y) {
-                new_adj[INDEX(row_map[x], row_map[y], size)] =
-                    curr_adj[INDEX(x, y, size)];
-            }
-        }
-        memcpy(reorderschedule, new_adj, size * size * sizeof(int));
-    } else {
-        memcpy(reorderschedule, curr_adj, size * size * sizeof(int));
+        for(uint64_t m = adj.row(v); m != 0; m &= m - 1)
+            links[__builtin_ctzll(m)]--;
+        placed[v] = false;
+        order.pop_back();
     }
-
-    // printf("\nCanonical Mapping:\n");
-    // for(int i = 0; i < size; ++i) {
-    //     for(int j = 0; j < size; ++j)
-    //         printf("%d", reorderschedule[INDEX(i,j,size)]);
-    //     puts("");
-    // }
 }
 
 void Schedule::add_edge(int x, int y)
 {
-    adj_mat[INDEX(x, y, size)] = 1;
-    adj_mat[INDEX(y, x, size)] = 1;
+    adj.add_edge(x, y);
 }
 
 void Schedule::del_edge(int x, int y)
 {
-    adj_mat[INDEX(x, y, size)] = 0;
-    adj_mat[INDEX(y, x, size)] = 0;
+    adj.del_edge(x, y);
 }
 
 void Schedule::add_update_mapping(int x, int y) {
-    adj_mat[INDEX(x, y, size)] = 2;
-    adj_mat[INDEX(y, x, size)] = 2;
+    adj.add_update_mapping(x, y);
 }
 
 void Schedule::print_schedule() const{
     printf("Schedule:\n");
     for(int i = 0; i < size; ++i) {
         for(int j = 0; j < size; ++j)
-            printf("%d", adj_mat[INDEX(i,j,size)]);
+            printf("%d", adj.get(i, j));
         puts("");
     }
 }
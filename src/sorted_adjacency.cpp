@@ -0,0 +1,97 @@
+#include "../include/sorted_adjacency.h"
+#include <algorithm>
+#include <utility>
+
+
+namespace {
+
+// First position in [p, end) not below target, by exponential then binary
+// search: cheap when the target is close, as it mostly is in a leapfrog.
+const int* gallop(const int* p, const int* end, int target) {
+    size_t step = 1;
+    while (p + step < end && p[step] < target) {
+        p += step;
+        step <<= 1;
+    }
+    return std::lower_bound(p, std::min(p + step + 1, end), target);
+}
+
+}
+
+
+SortedAdjacency::SortedAdjacency(const AdjacencyMap& graph) {
+    lists.reserve(graph.size());
+    for (const auto& entry : graph) {
+        std::vector<int>& list = lists[entry.first];
+        list.assign(entry.second.begin(), entry.second.end());
+        std::sort(list.begin(), list.end());
+    }
+}
+
+void SortedAdjacency::add_edge(int u, int v) {
+    for (int i = 0; i < 2; ++i) {
+        std::vector<int>& list = lists[u];
+        auto it = std::lower_bound(list.begin(), list.end(), v);
+        if (it == list.end() || *it != v) list.insert(it, v);
+        std::swap(u, v);
+    }
+}
+
+void SortedAdjacency::remove_edge(int u, int v) {
+    for (int i = 0; i < 2; ++i) {
+        auto entry = lists.find(u);
+        if (entry != lists.end()) {
+            std::vector<int>& list = entry->second;
+            auto it = std::lower_bound(list.begin(), list.end(), v);
+            if (it != list.end() && *it == v) list.erase(it);
+        }
+        std::swap(u, v);
+    }
+}
+
+const std::vector<int>& SortedAdjacency::neighbors(int vertex) const {
+    static const std::vector<int> empty;
+    auto it = lists.find(vertex);
+    return it != lists.end() ? it->second : empty;
+}
+
+void SortedAdjacency::intersect(const std::vector<const std::vector<int>*>& lists, std::vector<int>& out,
+                                int lower, int upper) {
+    const size_t k = lists.size();
+    if (k == 0 || lower >= upper) return;
+
+    // (position, end) of every list, ordered by the value at the position
+    std::vector<std::pair<const int*, const int*>> cursors(k);
+    for (size_t i = 0; i < k; ++i) {
+        const int* begin = lists[i]->data();
+        const int* end = begin + lists[i]->size();
+        begin = std::lower_bound(begin, end, lower);
+        if (begin == end) return;
+        cursors[i] = std::make_pair(begin, end);
+    }
+    if (k == 1) {
+        for (const int* p = cursors[0].first; p != cursors[0].second && *p < upper; ++p) out.push_back(*p);
+        return;
+    }
+    std::sort(cursors.begin(), cursors.end(),
+              [](const std::pair<const int*, const int*>& a, const std::pair<const int*, const int*>& b) {
+                  return *a.first < *b.first;
+              });
+
+    // The cursor after the one that moved last is at the smallest value;
+    // once it equals the largest, every list holds it.
+    size_t p = 0;
+    int high = *cursors[k - 1].first;
+    while (high < upper) {
+        std::pair<const int*, const int*>& cursor = cursors[p];
+        if (*cursor.first == high) {
+            out.push_back(high);
+            ++cursor.first;
+        } else {
+            cursor.first = gallop(cursor.first, cursor.second, high);
+        }
+        if (cursor.first == cursor.second) return;
+        high = *cursor.first;
+        p = p + 1 == k ? 0 : p + 1;
+    }
+}
@@ -3,8 +3,166 @@
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 
+namespace {
+
+thread_local Customer* current_customer = nullptr;
+
+// per-thread xorshift generator for victim and placement choices
+uint64_t next_random() {
+    thread_local uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// nanoseconds on the steady clock, never 0 in practice
+int64_t clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the two halves of TaskManager::Spilled for either kind of task
+TaskItem itemOf(const TaskItem& task) { return task; }
+TaskItem itemOf(const std::shared_ptr<Task>&) { return TaskItem(); }
+std::shared_ptr<Task> taskOf(const TaskItem&) { return nullptr; }
+std::shared_ptr<Task> taskOf(const std::shared_ptr<Task>& task) { return task; }
+
+// A logical CPU and where it sits: its physical core and package, its
+// NUMA node, and its rank among the SMT siblings of the core.
+struct CpuInfo {
+    int cpu;
+    int package;
+    int core;
+    int node;
+    int sibling;
+};
+
+int read_int(const std::string& path, int fallback) {
+    std::ifstream in(path);
+    int value;
+    return in >> value ? value : fallback;
+}
+
+// CPUs in a sysfs list such as "0-3,8-11"
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        int first, last;
+        char dash;
+        std::stringstream r(range);
+        if (!(r >> first)) continue;
+        if (!(r >> dash >> last)) last = first;
+        for (int c = first; c <= last; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+// The given CPUs, or those the process may run on, with their topology as
+// sysfs describes it. Without sysfs every CPU is its own core on node 0.
+std::vector<CpuInfo> cpu_topology(std::vector<int> cpus) {
+#ifdef __linux__
+    if (cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int c = 0; c < CPU_SETSIZE; ++c) {
+                if (CPU_ISSET(c, &set)) cpus.push_back(c);
+            }
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c) cpus.push_back(c);
+    }
+
+    std::map<int, int> node_of;
+    for (int n = 0; n < 64; ++n) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        std::string list;
+        if (!std::getline(in, list)) continue;
+        for (int c : parse_cpu_list(list)) node_of[c] = n;
+    }
+
+    std::vector<CpuInfo> topology;
+    std::map<std::pair<int, int>, int> siblings;    // (package, core) -> CPUs seen
+    std::sort(cpus.begin(), cpus.end());
+    for (int c : cpus) {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(c) + "/topology/";
+        CpuInfo info;
+        info.cpu = c;
+        info.package = read_int(dir + "physical_package_id", 0);
+        info.core = read_int(dir + "core_id", c);
+        info.node = node_of.count(c) ? node_of[c] : 0;
+        info.sibling = siblings[std::make_pair(info.package, info.core)]++;
+        topology.push_back(info);
+    }
+    return topology;
+}
+
+}
+
+
+TaskManager& Customer::getManager() const {
+    return manager ? *manager : TaskManager::getInstance();
+}
+
+void* Customer::getScratch(size_t bytes) {
+    if (bytes > scratch_size) {
+        size_t words = (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        scratch.reset(new uint64_t[words]());
+        scratch_size = words * sizeof(uint64_t);
+    }
+    return scratch.get();
+}
+
+WorkerStats Customer::getStats() const {
+    WorkerStats stats;
+    stats.id = customer_id;
+    stats.cpu = cpu;
+    stats.node = node;
+    stats.tasks_executed = counters.tasks_executed.load(std::memory_order_relaxed);
+    stats.steals = counters.steals.load(std::memory_order_relaxed);
+    stats.failed_steals = counters.failed_steals.load(std::memory_order_relaxed);
+    // A span still open is counted up to now; one that closes during the
+    // snapshot may be left out of it.
+    uint64_t busy_ns = counters.busy_ns.load(std::memory_order_relaxed);
+    uint64_t parked_ns = counters.parked_ns.load(std::memory_order_relaxed);
+    int64_t now = clock_ns();
+    int64_t busy_since = counters.busy_since.load(std::memory_order_relaxed);
+    int64_t parked_since = counters.parked_since.load(std::memory_order_relaxed);
+    stats.busy_ms = (busy_ns + (busy_since ? now - busy_since : 0)) / 1e6;
+    stats.parked_ms = (parked_ns + (parked_since ? now - parked_since : 0)) / 1e6;
+    for (int b = 0; b < WorkerStats::depth_buckets; ++b) {
+        stats.queue_depth[b] = counters.queue_depth[b].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+WorkerStats WorkerStats::since(const WorkerStats& earlier) const {
+    WorkerStats delta = *this;
+    delta.tasks_executed -= earlier.tasks_executed;
+    delta.steals -= earlier.steals;
+    delta.failed_steals -= earlier.failed_steals;
+    delta.busy_ms -= earlier.busy_ms;
+    delta.parked_ms -= earlier.parked_ms;
+    for (int b = 0; b < depth_buckets; ++b) delta.queue_depth[b] -= earlier.queue_depth[b];
+    return delta;
+}
+
 void Customer::start() {
     if (!is_running) {
         is_running = true;
@@ -15,31 +173,234 @@ void Customer::start() {
 void Customer::stop() {
     if (is_running) {
         is_running = false;
+        wake();
         if (worker_thread.joinable()) {
             worker_thread.join();
         }
     }
 }
 
+// Spin, then park: an idle worker keeps retrying for spin_rounds rounds,
+// pausing and later yielding between them, which covers bursts of
+// submissions, and then sleeps until wake().
 void Customer::run() {
+    current_customer = this;
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            std::cerr << "Customer " << customer_id << " could not be pinned to CPU " << cpu << std::endl;
+        }
+    }
+#endif
+    TaskManager& manager = getManager();
+    size_t idle = 0;
+    TaskItem task;
+    std::shared_ptr<Task> spilled;
+    auto end_busy = [this]() {
+        int64_t since = counters.busy_since.load(std::memory_order_relaxed);
+        if (since == 0) return;
+        count(counters.busy_ns, clock_ns() - since);
+        counters.busy_since.store(0, std::memory_order_relaxed);
+    };
     while (is_running) {
-        auto task = getTask();
-        
-        if (!task) {
-            task = TaskManager::getInstance().tryStealTask(*this);
+        bool found = getTask(task) || manager.takeOverflow(task, spilled);
+        if (!found) {
+            found = manager.tryStealTask(*this, task);
+            count(found ? counters.steals : counters.failed_steals);
         }
-        
-        if (task) {
-            processTask(*task);
+        if (found) {
+            if (counters.busy_since.load(std::memory_order_relaxed) == 0) {
+                counters.busy_since.store(clock_ns(), std::memory_order_relaxed);
+            }
+            count(counters.tasks_executed);
+            if (counters.tasks_executed.load(std::memory_order_relaxed) % depth_sample_interval == 0) sampleDepth();
+            idle = 0;
+            manager.notifySpace();
+            if (spilled) {
+                processTask(*spilled);
+                spilled.reset();
+            } else {
+                task.run();
+            }
+            continue;
+        }
+
+        end_busy();
+        if (++idle < spin_rounds) {
+#if defined(__x86_64__) || defined(__i386__)
+            if (idle < spin_rounds / 4) {
+                __builtin_ia32_pause();
+                continue;
+            }
+#endif
+            // let an oversubscribed core run the workers that have tasks
+            std::this_thread::yield();
         } else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            idle = 0;
+            park();
         }
     }
+    end_busy();
+}
+
+void Customer::sampleDepth() {
+    size_t depth = getLoad();
+    int bucket = 0;
+    while (depth > 0 && bucket < WorkerStats::depth_buckets - 1) {
+        depth >>= 1;
+        ++bucket;
+    }
+    count(counters.queue_depth[bucket]);
+}
+
+// parked is raised before the queue is checked a last time, and wake()
+// queues before it reads parked, both behind full fences: either the
+// check sees the task or wake() sees the worker parked.
+void Customer::park() {
+    std::unique_lock<std::mutex> lock(park_mutex);
+    parked.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    TaskManager& manager = getManager();
+    if (hasWork() || manager.getOverflowSize() > 0 || !is_running) {
+        parked.store(false);
+        return;
+    }
+    manager.notifyParked(1);
+    counters.parked_since.store(clock_ns(), std::memory_order_relaxed);
+    park_cv.wait(lock, [this] { return !parked.load() || !is_running; });
+    count(counters.parked_ns, clock_ns() - counters.parked_since.load(std::memory_order_relaxed));
+    counters.parked_since.store(0, std::memory_order_relaxed);
+    manager.notifyParked(-1);
+}
+
+bool Customer::addTask(const TaskItem& task) {
+    return current_customer == this ? work_queue->pushLocal(task) : work_queue->push(task);
+}
+
+bool Customer::addTask(std::shared_ptr<Task> task) {
+    uint32_t index;
+    int priority = task->getPriority();
+    if (!task_pool.put(std::move(task), index)) return false;
+    if (addTask(TaskItem::make(PooledTask{&task_pool, index}, priority))) return true;
+    task_pool.take(index);
+    return false;
+}
+
+Customer* Customer::current() {
+    return current_customer;
+}
+
+void Customer::PooledTask::operator()() const {
+    std::shared_ptr<Task> task = pool->take(index);
+    current_customer->processTask(*task);
 }
 
+bool Customer::wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!parked.load() || !parked.exchange(false)) return false;
+    std::lock_guard<std::mutex> lock(park_mutex);
+    park_cv.notify_one();
+    return true;
+}
+
+
+bool Producer::submitTask(std::shared_ptr<Task> task) {
+    if (!manager) manager = &TaskManager::getInstance();
+    return manager->submitTask(task);
+}
+
+TaskManager::Registry::~Registry() {
+    for (auto& entry : pools) delete entry.second;
+}
+
+TaskManager& TaskManager::getPool(const std::string& name) {
+    static Registry registry;
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    TaskManager*& pool = registry.pools[name];
+    if (!pool) pool = new TaskManager(name);
+    return *pool;
+}
 
-void Producer::submitTask(std::shared_ptr<Task> task) {
-    TaskManager::getInstance().submitTask(task);
+Reactor& Reactor::getInstance() {
+    static Reactor reactor;
+    return reactor;
+}
+
+Reactor::Reactor() : stopping(false) {
+    if (pipe(wake_pipe) != 0) {
+        std::cerr << "Error: Could not create the reactor wake pipe" << std::endl;
+        wake_pipe[0] = wake_pipe[1] = -1;
+        return;
+    }
+    for (int fd : wake_pipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    thread = std::thread(&Reactor::run, this);
+}
+
+Reactor::~Reactor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    if (thread.joinable()) {
+        char byte = 0;
+        (void)!write(wake_pipe[1], &byte, 1);
+        thread.join();
+    }
+    for (int fd : wake_pipe) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+void Reactor::watch(int fd, short events, TaskManager& pool, const TaskItem& task) {
+    if (!thread.joinable()) {
+        // no reactor thread: degrade to requeueing the task
+        pool.submitTask(task);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        watches.push_back({fd, events, &pool, task});
+    }
+    // a full pipe already has a wakeup pending
+    char byte = 0;
+    (void)!write(wake_pipe[1], &byte, 1);
+}
+
+void Reactor::run() {
+    std::vector<pollfd> fds;
+    std::vector<Watch> ready;
+    while (true) {
+        fds.assign(1, pollfd{wake_pipe[0], POLLIN, 0});
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+            for (const Watch& w : watches) fds.push_back(pollfd{w.fd, w.events, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) continue;     // EINTR
+
+        if (fds[0].revents) {
+            char buffer[64];
+            while (read(wake_pipe[0], buffer, sizeof(buffer)) > 0) {}
+        }
+        {
+            // watches only grow behind our back, so the first fds.size() - 1
+            // are still the ones polled
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = fds.size() - 1; i > 0; --i) {
+                if (!fds[i].revents) continue;
+                ready.push_back(watches[i - 1]);
+                watches.erase(watches.begin() + (i - 1));
+            }
+        }
+        for (const Watch& w : ready) w.pool->submitTask(w.task);
+        ready.clear();
+    }
 }
 
 TaskManager::~TaskManager() {
@@ -47,139 +408,217 @@ TaskManager::~TaskManager() {
 }
 
 void TaskManager::start() {
-    if (!is_running) {
-        is_running = true;
-        total_tasks = 0;
-        dispatcher_thread = std::thread(&TaskManager::dispatchTasks, this);
-    }
+    is_running = true;
 }
 
 void TaskManager::stop() {
     if (is_running) {
+        std::lock_guard<std::mutex> lock(space_mutex);
         is_running = false;
-        if (dispatcher_thread.joinable()) {
-            dispatcher_thread.join();
-        }
+        space_cv.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(customer_mutex);
+    for (auto& customer : customers) {
+        customer->stop();
     }
 }
 
 void TaskManager::addCustomer(std::shared_ptr<Customer> customer) {
     std::lock_guard<std::mutex> lock(customer_mutex);
+    size_t n = customer_count.load(std::memory_order_relaxed);
+    if (n == max_customers) {
+        std::cerr << "TaskManager supports at most " << max_customers << " customers" << std::endl;
+        return;
+    }
+    if (customer->isPlaced()) {
+        std::cerr << "Customer " << customer->getId() << " already belongs to a pool" << std::endl;
+        return;
+    }
+    Slot slot = placement.empty() ? Slot{-1, 0} : placement[next_slot++ % placement.size()];
+    customer->place(this, slot.cpu, slot.node);
+    customer->setLanePolicy(lane_policy);
     customers.push_back(customer);
+    workers[n].store(customer.get(), std::memory_order_relaxed);
+    customer_count.store(n + 1, std::memory_order_release);
     customer->start();
 }
 
-void TaskManager::addProducer(std::shared_ptr<Producer> producer) {
+void TaskManager::setCpuSet(const std::vector<int>& cpus, bool smt) {
+    std::vector<CpuInfo> topology = cpu_topology(cpus);
+    std::stable_sort(topology.begin(), topology.end(), [](const CpuInfo& a, const CpuInfo& b) {
+        if (a.sibling != b.sibling) return a.sibling < b.sibling;
+        if (a.node != b.node) return a.node < b.node;
+        if (a.package != b.package) return a.package < b.package;
+        return a.core < b.core;
+    });
+
     std::lock_guard<std::mutex> lock(customer_mutex);
-    producers.push_back(producer);
+    placement.clear();
+    next_slot = 0;
+    for (const CpuInfo& info : topology) {
+        if (smt || info.sibling == 0) placement.push_back(Slot{info.cpu, info.node});
+    }
 }
 
-void TaskManager::submitTask(std::shared_ptr<Task> task) {
-    scheduleTask(task);
-    total_tasks++;
+void TaskManager::setLanePolicy(LanePolicy policy) {
+    std::lock_guard<std::mutex> lock(customer_mutex);
+    lane_policy = policy;
+    for (auto& customer : customers) {
+        customer->setLanePolicy(policy);
+    }
+}
 
-    if (total_tasks > load_balance_threshold) {
-        balanceLoad();
+std::vector<WorkerStats> TaskManager::getStats() const {
+    std::vector<WorkerStats> stats;
+    size_t n = customer_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+        stats.push_back(workers[i].load(std::memory_order_relaxed)->getStats());
     }
+    return stats;
 }
 
-void TaskManager::scheduleTask(std::shared_ptr<Task> task) {
+void TaskManager::addProducer(std::shared_ptr<Producer> producer) {
     std::lock_guard<std::mutex> lock(customer_mutex);
-    
-    int min_load = std::numeric_limits<int>::max();
-    int target_idx = 0;
-    
-    #pragma omp parallel for
-    for (size_t i = 0; i < customers.size(); ++i) {
-        int load = static_cast<int>(customers[i]->work_queue->getSize());
-        #pragma omp critical
-        {
-            if (load < min_load) {
-                min_load = load;
-                target_idx = static_cast<int>(i);
-            }
+    producers.push_back(producer);
+}
+
+bool TaskManager::submitTask(std::shared_ptr<Task> task) {
+    return submit(task);
+}
+
+bool TaskManager::submitTask(const TaskItem& task) {
+    return submit(task);
+}
+
+// A producer that blocks registers in blocked_producers before its last
+// attempt, and a worker reads it after taking a task, both behind full
+// fences, so room made after that attempt always wakes the producer.
+// Blocked producers give up when the manager stops.
+template <typename T>
+bool TaskManager::submit(const T& task) {
+    Customer* self = Customer::current();
+    if (self && &self->getManager() != this) self = nullptr;
+    Customer* target = self ? self : selectCustomer();
+    if (!target) return false;
+    if (target->addTask(task) || (self && (target = selectCustomer()) != self && target->addTask(task))) {
+        // a worker's own deque: it is running, so only a thief can take the
+        // task sooner
+        if (target == self) {
+            wakeIdle(self);
+        } else {
+            taskQueued(target);
         }
+        return true;
     }
-    
-    if (target_idx < customers.size()) {
-        customers[target_idx]->addTask(task);
-    }
-}
 
-std::shared_ptr<Task> TaskManager::tryStealTask(const Customer& thief) {
-    std::lock_guard<std::mutex> lock(customer_mutex);
-    
-    std::vector<size_t> indices(customers.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(indices.begin(), indices.end(), g);
-    
+    OverflowPolicy policy = overflow_policy.load(std::memory_order_relaxed);
+    if (policy == SHED) {
+        shed_tasks.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (policy == SPILL && spill(itemOf(task), taskOf(task))) return true;
+    if (self) {
+        // a worker that blocked might be waiting for itself
+        self->runInline(task);
+        return true;
+    }
 
-    for (size_t i = 0; i < customers.size(); ++i) {
-        if (customers[indices[i]].get() != &thief && customers[indices[i]]->hasWork()) {
-            return customers[indices[i]]->stealTask();
+    std::unique_lock<std::mutex> lock(space_mutex);
+    blocked_producers.fetch_add(1);
+    bool queued = false;
+    while (is_running) {
+        target = selectCustomer();
+        if (target->addTask(task)) {
+            queued = true;
+            break;
         }
+        if (policy == SPILL && spill(itemOf(task), taskOf(task))) {
+            blocked_producers.fetch_sub(1);
+            return true;
+        }
+        space_cv.wait(lock);
     }
-    
-    return nullptr;
+    blocked_producers.fetch_sub(1);
+    lock.unlock();
+
+    if (queued) taskQueued(target);
+    return queued;
 }
 
-void TaskManager::balanceLoad() {
-    std::lock_guard<std::mutex> lock(customer_mutex);
-    
-    size_t total_load = 0;
-    for (const auto& customer : customers) {
-        total_load += customer->work_queue->getSize();
+bool TaskManager::spill(const TaskItem& task, const std::shared_ptr<Task>& spilled) {
+    {
+        std::lock_guard<std::mutex> lock(overflow_mutex);
+        if (overflow.size() >= overflow_capacity) return false;
+        overflow.push_back(Spilled{task, spilled});
+        overflow_size.store(overflow.size());
     }
-    size_t avg_load = total_load / customers.size();
-    
+    // the customer that was full is busy; one that is parked can drain it
+    wakeIdle(nullptr);
+    return true;
+}
 
-    #pragma omp parallel for
-    for (size_t i = 0; i < customers.size(); ++i) {
-        auto& customer = customers[i];
-        size_t current_load = customer->work_queue->getSize();
-        
-        if (current_load > avg_load) {
-
-            size_t tasks_to_transfer = current_load - avg_load;
-            for (size_t j = 0; j < tasks_to_transfer && customer->hasWork(); ++j) {
-                auto task = customer->stealTask();
-                if (task) {
-                    size_t target_idx = i;
-                    size_t min_load = current_load;
-                    
-                    for (size_t k = 0; k < customers.size(); ++k) {
-                        if (k != i) {
-                            size_t load = customers[k]->work_queue->getSize();
-                            if (load < min_load) {
-                                min_load = load;
-                                target_idx = k;
-                            }
-                        }
-                    }
-                    
-                    if (target_idx != i) {
-                        customers[target_idx]->addTask(task);
-                    } else {
-
-                        customer->addTask(task);
-                    }
-                }
-            }
-        }
+bool TaskManager::takeOverflow(TaskItem& task, std::shared_ptr<Task>& spilled) {
+    if (overflow_size.load(std::memory_order_relaxed) == 0) return false;
+    std::lock_guard<std::mutex> lock(overflow_mutex);
+    if (overflow.empty()) return false;
+    task = overflow.front().item;
+    spilled = std::move(overflow.front().task);
+    overflow.pop_front();
+    overflow_size.store(overflow.size());
+    return true;
+}
+
+void TaskManager::setOverflowPolicy(OverflowPolicy policy, size_t capacity) {
+    std::lock_guard<std::mutex> lock(overflow_mutex);
+    overflow_capacity = capacity;
+    overflow_policy.store(policy);
+}
+
+void TaskManager::taskQueued(Customer* target) {
+    // a parked owner takes it itself; behind a busy one even a single task
+    // could wait for a long one to finish, so a parked thief is woken for it
+    if (!target->wake()) {
+        wakeIdle(target);
     }
-    
-    total_tasks = 0;
 }
 
-void TaskManager::dispatchTasks() {
-    while (is_running) {
-        if (total_tasks > load_balance_threshold) {
-            balanceLoad();
+void TaskManager::wakeIdle(const Customer* busy) {
+    if (parked_customers.load(std::memory_order_relaxed) <= 0) return;
+    size_t n = customer_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+        Customer* customer = workers[i].load(std::memory_order_relaxed);
+        if (customer != busy && customer->isParked() && customer->wake()) return;
+    }
+}
+
+Customer* TaskManager::selectCustomer() {
+    size_t n = customer_count.load(std::memory_order_acquire);
+    if (n == 0) return nullptr;
+    uint64_t r = next_random();
+    Customer* first = workers[r % n].load(std::memory_order_relaxed);
+    Customer* second = workers[(r >> 32) % n].load(std::memory_order_relaxed);
+    return second->getLoad() < first->getLoad() ? second : first;
+}
+
+// Visits every other customer once per lane, those on the thief's NUMA
+// node first, starting at a random one, without locks: the victim order
+// comes from a per-thread xorshift generator.
+bool TaskManager::tryStealTask(const Customer& thief, TaskItem& task) {
+    size_t n = customer_count.load(std::memory_order_acquire);
+    if (n < 2) return false;
+
+    size_t start = next_random() % n;
+    for (int lane = WorkQueue::lanes - 1; lane >= 0; --lane) {
+        for (int remote = 0; remote < 2; ++remote) {
+            for (size_t i = 0; i < n; ++i) {
+                Customer* victim = workers[(start + i) % n].load(std::memory_order_relaxed);
+                if (victim == &thief || (victim->getNode() != thief.getNode()) != (remote == 1)) continue;
+                if (victim->getLoad(lane) > 0 && victim->stealTask(lane, task)) return true;
+            }
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
+    
+    return false;
 }
 
 std::shared_ptr<Customer> TaskManager::getAvailableCustomer() {
@@ -0,0 +1,149 @@
+#include "../include/task_manager.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+// Scaling benchmark of the TaskManager runtime: fine-grained tasks of a few
+// hundred nanoseconds each, run on 1, 2, 4, ... customers, once as string
+// Tasks and once as typed TaskItems. The pool grows between rounds, since
+// customers cannot be removed from the TaskManager.
+
+namespace {
+
+std::atomic<size_t> completed(0);
+std::atomic<uint64_t> checksum(0);
+size_t work_per_task = 64;
+
+void spin(uint64_t seed) {
+    uint64_t x = seed + 1;
+    for (size_t i = 0; i < work_per_task; ++i) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+    checksum.fetch_add(x & 1, std::memory_order_relaxed);
+    completed.fetch_add(1, std::memory_order_release);
+}
+
+class SpinCustomer : public Customer {
+public:
+    explicit SpinCustomer(const std::string& id) : Customer(id) {}
+
+protected:
+    void processTask(const Task& task) override {
+        spin(static_cast<uint64_t>(task.getPriority()));
+    }
+};
+
+// Submits tasks through submit(i), as fast as the overflow policy lets it,
+// and waits for all that were accepted; milliseconds.
+template <typename Submit>
+double run_round(size_t tasks, const Submit& submit) {
+    completed = 0;
+    size_t accepted = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t submitted = 0; submitted < tasks; ++submitted) {
+        if (submit(submitted)) ++accepted;
+    }
+    while (completed.load(std::memory_order_acquire) < accepted) {
+        std::this_thread::yield();
+    }
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+
+int main(int argc, char* argv[]) {
+    size_t tasks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    work_per_task = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64;
+    size_t max_threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 64;
+    bool pin = argc > 4 && std::string(argv[4]) == "pin";
+    if (tasks == 0 || max_threads == 0) {
+        printf("Usage: %s [tasks] [work_per_task] [max_threads] [pin]\n", argv[0]);
+        return 0;
+    }
+
+    TaskManager& manager = TaskManager::getPool("scaling");
+    if (pin) manager.setCpuSet();
+    manager.start();
+
+    printf("%8s %16s %16s %10s\n", "threads", "string tasks/s", "typed tasks/s", "speedup");
+    size_t customers = 0;
+    double single = 0;
+    std::shared_ptr<Task> task = std::make_shared<Task>("spin", "benchmark", "");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        while (customers < threads) {
+            manager.addCustomer(std::make_shared<SpinCustomer>("customer-" + std::to_string(customers++)));
+        }
+
+        double string_ms = run_round(tasks, [&](size_t) { return manager.submitTask(task); });
+        double typed_ms = run_round(tasks, [&](size_t i) { return manager.submitTask(TaskItem::make([i] { spin(i); })); });
+
+        if (threads == 1) single = typed_ms;
+        printf("%8zu %16.0f %16.0f %10.2f\n", threads, tasks / string_ms * 1000.0, tasks / typed_ms * 1000.0,
+               single / typed_ms);
+    }
+
+    // a producer that outruns the pool, under each overflow policy
+    printf("%8s %12s %14s %10s\n", "overflow", "time (ms)", "tasks/s", "shed");
+    const char* overflow_names[] = {"block", "spill", "shed"};
+    OverflowPolicy overflow_policies[] = {BLOCK, SPILL, SHED};
+    for (int p = 0; p < 3; ++p) {
+        manager.setOverflowPolicy(overflow_policies[p], tasks / 4);
+        size_t shed = manager.getShedCount();
+        double ms = run_round(tasks, [&](size_t i) { return manager.submitTask(TaskItem::make([i] { spin(i); })); });
+        printf("%8s %12.2f %14.0f %10zu\n", overflow_names[p], ms, tasks / ms * 1000.0, manager.getShedCount() - shed);
+    }
+    manager.setOverflowPolicy(BLOCK);
+
+    // an urgent task submitted behind a backlog of background work
+    printf("%8s %16s %16s\n", "lanes", "queued ahead", "ran after");
+    LanePolicy policies[] = {STRICT, WEIGHTED};
+    for (LanePolicy policy : policies) {
+        manager.setLanePolicy(policy);
+        size_t backlog = customers * 500;
+        completed = 0;
+        for (size_t i = 0; i < backlog; ++i) {
+            manager.submitTask(TaskItem::make([i] { spin(i); }, -1));
+        }
+        static std::atomic<size_t> ran_at;
+        ran_at = 0;
+        size_t submitted_at = completed.load(std::memory_order_acquire);
+        manager.submitTask(TaskItem::make([] { ran_at = completed.load() + 1; }, 1));
+        while (completed.load(std::memory_order_acquire) < backlog || ran_at == 0) {
+            std::this_thread::yield();
+        }
+        printf("%8s %16zu %16zu\n", policy == STRICT ? "strict" : "weighted", backlog - submitted_at,
+               ran_at - 1 - submitted_at);
+    }
+    manager.setLanePolicy(STRICT);
+
+    // a single task submitted to a pool whose workers have all parked
+    const int probes = 100;
+    double wakeup_us = 0;
+    std::shared_ptr<Task> probe = std::make_shared<Task>("probe", "benchmark", "");
+    for (int i = 0; i < probes; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        size_t before = completed.load(std::memory_order_acquire);
+        auto start = std::chrono::steady_clock::now();
+        manager.submitTask(probe);
+        while (completed.load(std::memory_order_acquire) == before) {
+            std::this_thread::yield();
+        }
+        wakeup_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+    printf("Wakeup latency of a parked pool: %.1f us (mean of %d)\n", wakeup_us / probes, probes);
+
+    // what each worker did over the whole benchmark
+    printf("%12s %10s %10s %14s %10s %12s\n", "worker", "tasks", "steals", "failed steals", "busy (ms)", "parked (ms)");
+    for (const WorkerStats& stats : manager.getStats()) {
+        printf("%12s %10llu %10llu %14llu %10.0f %12.0f\n", stats.id.c_str(),
+               static_cast<unsigned long long>(stats.tasks_executed), static_cast<unsigned long long>(stats.steals),
+               static_cast<unsigned long long>(stats.failed_steals), stats.busy_ms, stats.parked_ms);
+    }
+
+    manager.stop();
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "../include/update_batch.h"
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+
+
+bool UpdateBatch::parse_line(const std::string& line, EdgeUpdate& update) {
+    std::istringstream iss(line);
+    std::string first;
+    if (!(iss >> first)) return false;
+
+    update.is_insert = true;
+    if (first == "+" || first == "-") {
+        update.is_insert = (first == "+");
+        return static_cast<bool>(iss >> update.u >> update.v);
+    }
+
+    std::istringstream head(first);
+    if (!(head >> update.u)) return false;
+    return static_cast<bool>(iss >> update.v);
+}
+
+
+std::vector<EdgeUpdate> UpdateBatch::compact(const std::function<bool(int, int)>& has_edge,
+                                             CompactionStats* stats) const {
+    struct EdgeState {
+        bool initial;
+        bool current;
+        size_t changes;
+        size_t last_pos;
+    };
+
+    CompactionStats local = {updates.size(), 0, 0, 0, 0};
+    std::unordered_map<uint64_t, EdgeState> states;
+    states.reserve(updates.size());
+
+    for (size_t i = 0; i < updates.size(); ++i) {
+        const EdgeUpdate& up = updates[i];
+        if (up.u == up.v) {
+            local.self_loops++;
+            continue;
+        }
+
+        uint64_t key = edge_key(up.u, up.v);
+        auto it = states.find(key);
+        if (it == states.end()) {
+            bool present = has_edge(up.u, up.v);
+            it = states.emplace(key, EdgeState{present, present, 0, i}).first;
+        }
+
+        EdgeState& st = it->second;
+        if (st.current == up.is_insert) {
+            local.redundant++;
+            continue;
+        }
+        st.current = up.is_insert;
+        st.changes++;
+        st.last_pos = i;
+    }
+
+    std::vector<size_t> positions;
+    for (const auto& entry : states) {
+        const EdgeState& st = entry.second;
+        if (st.initial != st.current) {
+            positions.push_back(st.last_pos);
+            local.cancelled += st.changes - 1;
+        } else {
+            local.cancelled += st.changes;
+        }
+    }
+    std::sort(positions.begin(), positions.end());
+
+    std::vector<EdgeUpdate> net;
+    net.reserve(positions.size());
+    for (size_t pos : positions) {
+        net.push_back(updates[pos]);
+    }
+    local.net_updates = net.size();
+
+    if (stats) *stats = local;
+    return net;
+}
+
+
+std::vector<EndpointGroup> UpdateBatch::group_by_endpoint(const std::vector<EdgeUpdate>& updates) {
+    std::vector<EndpointGroup> groups;
+
+    for (size_t i = 0; i < updates.size(); ++i) {
+        const EdgeUpdate& up = updates[i];
+
+        if (!groups.empty()) {
+            EndpointGroup& last = groups.back();
+            if (last.updates.size() == 1) {
+                const EdgeUpdate& head = last.updates[0];
+                if (up.u == head.u || up.u == head.v) {
+                    last.shared = up.u;
+                    last.updates.push_back(up);
+                    continue;
+                }
+                if (up.v == head.u || up.v == head.v) {
+                    last.shared = up.v;
+                    last.updates.push_back(up);
+                    continue;
+                }
+            } else if (up.u == last.shared || up.v == last.shared) {
+                last.updates.push_back(up);
+                continue;
+            }
+        }
+
+        groups.push_back(EndpointGroup{up.v, i, {up}});
+    }
+
+    return groups;
+}
+
+
+EdgeTimeline::EdgeTimeline(const std::vector<EdgeUpdate>& net) {
+    edges.reserve(net.size());
+    for (size_t i = 0; i < net.size(); ++i) {
+        edges[edge_key(net[i].u, net[i].v)] = std::make_pair(i, net[i].is_insert);
+    }
+}
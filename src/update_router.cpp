@@ -0,0 +1,80 @@
+#include "../include/update_router.h"
+#include <algorithm>
+#include <cmath>
+
+
+void LaneStats::record(double latency_us) {
+    updates++;
+    total_latency_us += latency_us;
+    max_latency_us = std::max(max_latency_us, latency_us);
+
+    int b = 0;
+    while (b < num_buckets - 1 && (1ULL << b) <= latency_us) ++b;
+    histogram[b]++;
+}
+
+void LaneStats::merge(const LaneStats& other) {
+    updates += other.updates;
+    groups += other.groups;
+    total_latency_us += other.total_latency_us;
+    max_latency_us = std::max(max_latency_us, other.max_latency_us);
+    for (int b = 0; b < num_buckets; ++b) {
+        histogram[b] += other.histogram[b];
+    }
+}
+
+double LaneStats::mean_latency_us() const {
+    return updates ? total_latency_us / updates : 0.0;
+}
+
+double LaneStats::percentile_us(double p) const {
+    if (updates == 0) return 0.0;
+    size_t rank = static_cast<size_t>(std::ceil(p * updates));
+    size_t seen = 0;
+    for (int b = 0; b < num_buckets; ++b) {
+        seen += histogram[b];
+        if (seen >= rank && seen > 0) {
+            return std::min(static_cast<double>(1ULL << b), max_latency_us);
+        }
+    }
+    return max_latency_us;
+}
+
+
+UpdateRouter::UpdateRouter(double heavy_threshold_us)
+    : heavy_threshold_us(heavy_threshold_us),
+      us_per_work(num_buckets, 0.01),
+      samples(num_buckets, 0) {
+}
+
+double UpdateRouter::work_of(size_t deg_u, size_t deg_v) {
+    // The nested loops of the mining kernels scale with the product of the
+    // endpoint degrees; the sum keeps leaf updates from estimating to zero.
+    return static_cast<double>(deg_u) * deg_v + deg_u + deg_v + 1.0;
+}
+
+int UpdateRouter::bucket_of(double work) {
+    int b = static_cast<int>(std::log2(work));
+    return std::max(0, std::min(num_buckets - 1, b));
+}
+
+double UpdateRouter::estimate_us(size_t deg_u, size_t deg_v) const {
+    double work = work_of(deg_u, deg_v);
+    return work * us_per_work[bucket_of(work)];
+}
+
+UpdateLane UpdateRouter::route(double estimated_us) const {
+    return estimated_us > heavy_threshold_us ? UpdateLane::HEAVY : UpdateLane::FAST;
+}
+
+void UpdateRouter::observe(size_t deg_u, size_t deg_v, double elapsed_us) {
+    double work = work_of(deg_u, deg_v);
+    int b = bucket_of(work);
+    double sample = elapsed_us / work;
+
+    // Plain average while the bucket is young, exponential decay afterwards so
+    // the estimate follows the graph as it densifies.
+    samples[b]++;
+    double alpha = samples[b] < 16 ? 1.0 / samples[b] : 1.0 / 16;
+    us_per_work[b] += alpha * (sample - us_per_work[b]);
+}